@@ -144,6 +144,15 @@ class ServerTask {
      */
     virtual void reply(const void* response, size_t length) = 0;
 
+    /**
+     * Return the time at which the request arrived at the Socket and was
+     * queued to be returned by Socket::receive().
+     *
+     * @return
+     *      Arrival time of the request in PerfUtils::Cycles::rdtsc() cycles.
+     */
+    virtual uint64_t getArrivalTime() = 0;
+
   protected:
     /**
      * Destruct this ServerTask and free any associated memory.
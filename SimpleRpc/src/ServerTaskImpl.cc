@@ -15,6 +15,8 @@
 
 #include "ServerTaskImpl.h"
 
+#include <PerfUtils/Cycles.h>
+
 #include "Debug.h"
 #include "Perf.h"
 #include "SocketImpl.h"
@@ -40,6 +42,7 @@ ServerTaskImpl::ServerTaskImpl(SocketImpl* socket,
     , request(std::move(request))
     , replyAddress(socket->transport->getDriver()->getAddress(
           &requestHeader->replyAddress))
+    , arrivalTime(PerfUtils::Cycles::rdtsc())
 {
     this->request->strip(sizeof(Proto::RequestHeader));
 }
@@ -74,6 +77,15 @@ ServerTaskImpl::reply(const void* response, size_t length)
     Perf::counters.server_api_cycles.add(timer.split());
 }
 
+/**
+ * @copydoc ServerTask::getArrivalTime()
+ */
+uint64_t
+ServerTaskImpl::getArrivalTime()
+{
+    return arrivalTime;
+}
+
 /**
  * @copydoc ServerTask::destroy()
  */
@@ -41,6 +41,7 @@ class ServerTaskImpl : public ServerTask {
     virtual ~ServerTaskImpl();
     virtual Homa::InMessage* getRequest();
     virtual void reply(const void* response, size_t length);
+    virtual uint64_t getArrivalTime();
 
   protected:
     virtual void destroy();
@@ -60,6 +61,10 @@ class ServerTaskImpl : public ServerTask {
     /// Address of the client that sent the original request; the reply should
     /// be sent back to this address.
     Homa::Driver::Address const replyAddress;
+
+    /// Time in rdtsc cycles at which the request arrived; the task is queued
+    /// for receive() as soon as it is constructed.
+    uint64_t const arrivalTime;
 };
 
 }  // namespace SimpleRpc
@@ -13,6 +13,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <PerfUtils/Cycles.h>
 #include <gtest/gtest.h>
 
 #include "Mock/MockHoma.h"
@@ -92,11 +93,15 @@ TEST_F(ServerTaskImplTest, constructor)
         .WillOnce(Return(0xDEADBEEF));
     EXPECT_CALL(inMessage, strip(Eq(sizeof(Proto::RequestHeader))));
 
+    uint64_t before = PerfUtils::Cycles::rdtsc();
     ServerTaskImpl task(socket, &header, std::move(request));
+    uint64_t after = PerfUtils::Cycles::rdtsc();
     EXPECT_EQ(socket, task.socket);
     EXPECT_EQ(header.rpcId, task.rpcId);
     EXPECT_EQ(&inMessage, task.request.get());
     EXPECT_EQ(0xDEADBEEF, task.replyAddress);
+    EXPECT_LE(before, task.arrivalTime);
+    EXPECT_GE(after, task.arrivalTime);
 
     EXPECT_CALL(inMessage, release());
 }
@@ -125,6 +130,12 @@ TEST_F(ServerTaskImplTest, reply)
     task->reply(buffer, sizeof(buffer));
 }
 
+TEST_F(ServerTaskImplTest, getArrivalTime)
+{
+    initDefaultTask();
+    EXPECT_EQ(task->arrivalTime, task->getArrivalTime());
+}
+
 TEST_F(ServerTaskImplTest, destroy)
 {
     initDefaultTask();
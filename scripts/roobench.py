@@ -38,12 +38,18 @@ if __name__ == '__main__':
     elif args['<command>'] == 'run':
         import roobench_run
         roobench_run.main(docopt(roobench_run.__doc__, argv=argv))
+    elif args['<command>'] == 'search':
+        import roobench_search
+        roobench_search.main(docopt(roobench_search.__doc__, argv=argv))
     elif args['<command>'] == 'server':
         import roobench_server
         roobench_server.main(docopt(roobench_server.__doc__, argv=argv))
     elif args['<command>'] == 'stats':
         import roobench_stats
         roobench_stats.main(docopt(roobench_stats.__doc__, argv=argv))
+    elif args['<command>'] == 'top':
+        import roobench_top
+        roobench_top.main(docopt(roobench_top.__doc__, argv=argv))
     else:
         exit("%r is not a roobench.py command. See 'roobench help'."
              % args['<command>'])
@@ -16,22 +16,78 @@
 
 """
 Usage:
-    roobench.py config bench <server_list> <workload> [--clients=<n> --load=<ops> --nodes=<n> --out=<name> --unified]
-    roobench.py config server-list <server_config> <hostname>... [--out=<name>]
+    roobench.py config bench <server_list> <workload> [--clients=<n> --load=<ops> --nodes=<n> --out=<name> --unified --driver=<type> --client-threads=<n> --concurrency=<n> --think-time=<us> --max-outstanding=<n> --warmup=<s> --measurement=<s> --cooldown=<s> --sample-period=<ms> --live-stats-period=<ms> --stats-json --hugepages --interface=<if> --port=<n>]
+    roobench.py config server-list <server_config> <hostname>... [--out=<name> --driver=<type> --interface=<if> --port=<n>]
 
 Options:
-    -h, --help          Show this screen.
-    -c, --clients=<n>   Number of clients to run. [default: 1]
-    -l, --load=<ops>    The number operations per second. [default: 1000.0]
-    -n, --nodes=<n>     Number of host nodes to run (0 means all). [default: 0]
-    -o, --out=<name>    Output to the given file name.
-    -u, --unified       Node should run both client and server.
+    -h, --help              Show this screen.
+    -c, --clients=<n>       Number of clients to run. [default: 1]
+    --client-threads=<n>    Threads per node dedicated to the client role (0
+                            means every thread does both). [default: 0]
+    --cooldown=<s>          Seconds between the measurement window and the
+                            benchmark stopping on its own. [default: 1.0]
+    --concurrency=<n>       Ops each client keeps in flight (closed loop); 0
+                            means open loop at the rate of --load. [default: 0]
+    -d, --driver=<type>     Homa driver (dpdk, fake or udp). [default: dpdk]
+    --hugepages             Back the payloads each node sends with hugepages
+                            (falls back to regular pages if none are free).
+    --interface=<if>        Network interface whose IPv4 address the udp
+                            driver uses; server lists for the udp driver list
+                            each host's address on it. [default: eth0]
+    -l, --load=<ops>        The number operations per second. [default: 1000.0]
+    --max-outstanding=<n>   Open-loop ops each client keeps in flight;
+                            further ops wait or, once as many wait, are
+                            dropped. 0 derives the limit from the load.
+                            [default: 0]
+    --live-stats-period=<ms>
+                            Period in milliseconds at which each node
+                            publishes its live stats for roobench.py top; 0
+                            disables the publishing. [default: 100]
+    -m, --measurement=<s>   Length of the self-timed measurement window in
+                            seconds; 0 leaves stats dumps to the run script.
+                            [default: 0]
+    -n, --nodes=<n>         Number of host nodes to run (0 means all). [default: 0]
+    -o, --out=<name>        Output to the given file name.
+    --port=<n>              UDP port every node's udp driver binds.
+                            [default: 4000]
+    --sample-period=<ms>    Period in milliseconds at which each node samples
+                            its stats into a time series; 0 disables the
+                            sampling. [default: 0]
+    --stats-json            Write a JSON summary next to each binary stats
+                            dump.
+    --think-time=<us>       Closed-loop think time in microseconds. [default: 0]
+    -u, --unified           Node should run both client and server.
+    -w, --warmup=<s>        Seconds between the start and the measurement
+                            window. [default: 4.0]
 """
 
 import json
 import os
 import subprocess
 
+def name_servers(servers, role):
+    # Name the servers the way roobench_run.py names the nodes running them so
+    # per-server stats can be matched with the nodes' own stats.
+    return [dict(server, name="{}-{}".format(role, i + 1)) for i, server in enumerate(servers)]
+
+def get_ip_address(hostname, interface):
+    """
+    Return the IPv4 address of the given interface of a host.
+    """
+    p = subprocess.Popen(["ssh",
+                          hostname,
+                          "ip -4 -o addr show dev %s" % interface],
+                         shell=False,
+                         stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    output, error = p.communicate()
+    # Lines look like "2: eth0    inet 10.0.0.1/24 brd ... scope global eth0".
+    for line in output.splitlines():
+        fields = line.split()
+        if 'inet' in fields:
+            return fields[fields.index('inet') + 1].split('/')[0]
+    raise RuntimeError("No IPv4 address on %s of %s: %s" % (interface, hostname, error.strip()))
+
 def main(args):
     if args["bench"]:
         with open(args["<server_list>"]) as f:
@@ -44,7 +100,7 @@ def main(args):
             node_count = int(args['--nodes'])
         if args['--unified']:
             config["client_count"] = node_count
-            config["server_list"] = {u'servers': server_list['servers'][:node_count]}
+            config["server_list"] = {u'servers': name_servers(server_list['servers'][:node_count], 'client')}
             if node_count < 2:
                 print "Error: Need at least 2 server nodes (clients: {}, servers: {})".format(node_count, node_count)
                 return
@@ -54,10 +110,34 @@ def main(args):
                 print "Error: Need at least 2 server nodes (clients: {}, servers: {})".format(client_count, node_count - client_count)
                 return
             config["client_count"] = client_count
-            config["server_list"] = {u'servers': server_list['servers'][client_count:node_count]}
+            config["server_list"] = {u'servers': name_servers(server_list['servers'][client_count:node_count], 'server')}
         config["load"] = float(args['--load'])
         config["node_count"] = node_count
         config["unified"] = bool(args['--unified'])
+        config["client_threads"] = int(args['--client-threads'])
+        config["stats_json"] = bool(args['--stats-json'])
+        config["live_stats_period_ms"] = float(args['--live-stats-period'])
+        if args['--hugepages']:
+            config["payload_hugepages"] = True
+        if float(args['--sample-period']) > 0:
+            config["sample_period_ms"] = float(args['--sample-period'])
+        if int(args['--concurrency']) > 0:
+            config["closed_loop"] = {
+                "concurrency": int(args['--concurrency']),
+                "think_time_us": float(args['--think-time'])}
+        if int(args['--max-outstanding']) > 0:
+            config["max_outstanding"] = int(args['--max-outstanding'])
+        if float(args['--measurement']) > 0:
+            config["windows"] = {
+                "warmup": float(args['--warmup']),
+                "measurement": float(args['--measurement']),
+                "cooldown": float(args['--cooldown'])}
+        config["driver"] = {"type": args['--driver']}
+        if args['--driver'] == 'udp':
+            # Nodes find themselves in the server list by their address, so
+            # they all bind the port the list was generated with.
+            config["driver"]["interface"] = args['--interface']
+            config["driver"]["port"] = int(args['--port'])
         config["workload"] = workload
         if args["--out"]:
             with open(args["--out"], 'w') as f:
@@ -72,16 +152,20 @@ def main(args):
         server_list["servers"] = []
         serverid = 1
         for hostname in args["<hostname>"]:
-            p = subprocess.Popen(["ssh",
-                                hostname,
-                                "sudo %s" % getmac_bin],
-                                shell=False,
-                                stdout=subprocess.PIPE,
-                                stderr=subprocess.PIPE)
-            p.wait()
-            lines = p.stdout.readlines()
-            host_mac = lines[-1].strip('\n')
-            entry = {"id": serverid, "address": host_mac}
+            if args['--driver'] == 'udp':
+                # The udp driver addresses nodes by <ip>:<port>.
+                host_address = get_ip_address(hostname, args['--interface']) + ':' + args['--port']
+            else:
+                p = subprocess.Popen(["ssh",
+                                    hostname,
+                                    "sudo %s" % getmac_bin],
+                                    shell=False,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE)
+                p.wait()
+                lines = p.stdout.readlines()
+                host_address = lines[-1].strip('\n')
+            entry = {"id": serverid, "address": host_address}
             server_list["servers"].append(entry)
             serverid += 1
         if args["--out"]:
@@ -19,6 +19,7 @@ Usage:
     roobench.py plot latency <dataset_name> <data_dir>... [--out=<name>] [--dataout=<name>]
     roobench.py plot cpu-usage <dataset_name> <num_servers> <data_dir>...
     roobench.py plot merge <data_file>...
+    roobench.py plot timeseries <data_dir> <host_name>
 
 Options:
     -h, --help              Show this screen.
@@ -29,19 +30,15 @@ Options:
 import json
 import matplotlib.pyplot as plt
 
+from roobench_stats import get_timeseries, load_histogram, load_stats, percentile
+
 def load_latency(data_dir):
-    data_file = data_dir + '/server-1_bench_stats_1.json'
-    with open(data_file) as f:
-        data = json.load(f)
-    return data["client_stats"]["latencies"]
+    data = load_stats(data_dir + '/server-1_bench_stats_1')
+    return load_histogram(data["client_stats"]["latency"])
 
 def load_server_cpu_usage(data_dir, server_id):
-    start_data_file = data_dir + '/server-%d_transport_stats_0.json' % server_id
-    end_data_file = data_dir + '/server-%d_transport_stats_1.json' %server_id
-    with open(start_data_file) as f:
-        start_data = json.load(f)
-    with open(end_data_file) as f:
-        end_data = json.load(f)
+    start_data = load_stats(data_dir + '/server-%d_transport_stats_0' % server_id)
+    end_data = load_stats(data_dir + '/server-%d_transport_stats_1' % server_id)
     cpu_usage = end_data["active_cycles"] - start_data["active_cycles"]
     return cpu_usage
 
@@ -52,10 +49,6 @@ def load_cpu_usage(data_dir, num_servers):
         server_usage += load_server_cpu_usage(data_dir, i)
     return (client_usage, server_usage)
 
-def get_median(data):
-    data.sort()
-    return data[len(data)/2]
-
 def generate_latency_plot(x, y, data_name):
     plt.plot(x, y, '-o', label=data_name)
     plt.ylabel('End-to-end latency (us)')
@@ -66,7 +59,7 @@ def plot_latency(args):
     hops = 1
     for data_dir in args["<data_dir>"]:
         latencies = load_latency(data_dir)
-        median = get_median(latencies)
+        median = percentile(latencies, 0, 0.5)
         median = median / 1000.0
         y.append(median)
         x.append(hops)
@@ -87,12 +80,8 @@ def plot_latency(args):
 
 def plot_cpu_usage(args):
     for data_dir in args["<data_dir>"]:
-        start_client_data_file = data_dir + '/server-1_bench_stats_0.json'
-        end_client_data_file = data_dir + '/server-1_bench_stats_1.json'
-        with open(start_client_data_file) as f:
-            start_client_data = json.load(f)
-        with open(end_client_data_file) as f:
-            end_client_data = json.load(f)
+        start_client_data = load_stats(data_dir + '/server-1_bench_stats_0')
+        end_client_data = load_stats(data_dir + '/server-1_bench_stats_1')
         client_count = end_client_data["client_stats"]["count"] - start_client_data["client_stats"]["count"]
         
         (client_cycles, server_cycles) = load_cpu_usage(data_dir, int(args['<num_servers>']))
@@ -119,6 +108,31 @@ def plot_merge(args):
     plt.show()
     
 
+def plot_timeseries(args):
+    intervals = get_timeseries(args['<data_dir>'], args['<host_name>'])
+    if not intervals:
+        print "No time series for %s" % args['<host_name>']
+        return
+    x = [interval["time"] for interval in intervals]
+    fig, (ax_tput, ax_latency, ax_cpu) = plt.subplots(3, 1, sharex=True)
+    ax_tput.plot(x, [interval["throughput"] for interval in intervals])
+    ax_tput.set_ylabel('Throughput (kops)')
+    ax_latency.plot(x, [percentile(interval["latency"], interval["drops"], 0.5) / 1000.0 for interval in intervals], label='median')
+    ax_latency.plot(x, [percentile(interval["latency"], interval["drops"], 0.99) / 1000.0 for interval in intervals], label='99%')
+    ax_latency.set_ylabel('Latency (us)')
+    ax_latency.legend()
+    ax_cpu.plot(x, [interval["cpu_bench"] for interval in intervals], label='bench')
+    ax_cpu.plot(x, [interval["cpu_poll"] for interval in intervals], label='poll')
+    ax_cpu.set_ylabel('CPU (cores)')
+    ax_cpu.set_xlabel('Time (s)')
+    ax_cpu.legend()
+    for ax in (ax_tput, ax_latency, ax_cpu):
+        ax.set_ylim(bottom=0)
+    if args['--out']:
+        plt.savefig(args['--out'])
+    else:
+        plt.show()
+
 def main(args):
     if args["latency"]:
         plot_latency(args)
@@ -126,6 +140,8 @@ def main(args):
         plot_cpu_usage(args)
     elif args["merge"]:
         plot_merge(args)
+    elif args["timeseries"]:
+        plot_timeseries(args)
 
 if __name__ == '__main__':
     args = docopt(__doc__)
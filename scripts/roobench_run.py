@@ -16,13 +16,15 @@
 
 """
 Usage:
-    roobench.py run <config> <server_config> <bench_config> <log_dir> [--out=<outdir> --pause --verbose]
+    roobench.py run <config> <server_config> <bench_config> <log_dir> [--out=<outdir> --pause --verbose --start-delay=<sec>]
 
 Options:
-    -h, --help          Show this screen.
-    -o, --out=<outdir>  Name of the output directory; defaults to a date string.
-    -p, --pause         Wait for user before starting clients.
-    -v, --verbose       Print out the commands before they are run.
+    -h, --help                Show this screen.
+    -o, --out=<outdir>        Name of the output directory; defaults to a date string.
+    -p, --pause               Wait for user before starting clients.
+    -v, --verbose             Print out the commands before they are run.
+    -d, --start-delay=<sec>   Seconds between scheduling the synchronized start
+                              and the start itself [default: 2].
 """
 
 import json
@@ -51,6 +53,32 @@ def remote_call(host, cmd):
     p = subprocess.Popen('ssh {host} "{cmd}"'.format(host=host, cmd=cmd), shell=True)
     return p
 
+# Answers each line read from stdin with the local wall-clock time.
+CLOCK_PROBE = '''import sys, time
+for line in iter(sys.stdin.readline, ""):
+    sys.stdout.write(repr(time.time()) + "\\n")
+    sys.stdout.flush()'''
+
+def clock_offset(host, samples=10):
+    """
+    Estimate how far the host's wall clock is ahead of the local one.  The
+    round trip with the smallest delay bounds the error best.
+    """
+    p = subprocess.Popen(['ssh', host, "python -u -c '%s'" % CLOCK_PROBE],
+                         stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    best = None
+    for i in range(samples):
+        t0 = time.time()
+        p.stdin.write('\n')
+        p.stdin.flush()
+        remote = float(p.stdout.readline())
+        t1 = time.time()
+        if best is None or t1 - t0 < best[0]:
+            best = (t1 - t0, remote - (t0 + t1) / 2)
+    p.stdin.close()
+    p.wait()
+    return best[1]
+
 def setup_host(remote, log_dir_name):
     log_dir = "~/logs/{}".format(log_dir_name)
     p = remote_call(remote, 'mkdir -p {log_dir}; ln -sFfn {log_dir} ~/logs/latest'.format(log_dir=log_dir))
@@ -63,23 +91,7 @@ def coordinator_setup(log_dir, out_name, server_config, bench_config):
     shutil.copyfile(bench_config, test_dir + '/BenchConfig.json')
     return test_dir
 
-def main(args):
-    hosts, bin_dir, src_dir = read_config(args['<config>'])
-    remote_config_dir = '/shome/RooConfig'
-    date_time = datetime.now().strftime('%F-%H-%M-%S')
-    with open(os.path.expanduser(args["<bench_config>"])) as f:
-        bench_config = json.load(f)
-    client_count = bench_config['client_count']
-    if (args['--out'] is not None):
-        out_name = args['--out']
-    else:
-        out_name = date_time
-    out_dir = coordinator_setup(args['<log_dir>'],
-                      out_name,
-                      args['<server_config>'],
-                      args['<bench_config>'])
-    hosts = hosts[:bench_config['node_count']]
-
+def launch_servers(hosts, client_count, date_time, src_dir, remote_config_dir, verbose):
     tasks = []
 
     print "Setup Hosts..."
@@ -101,69 +113,51 @@ def main(args):
         else:
             server_name = "server-{}".format(SERVER_ID - client_count)
         cmd = 'sudo nohup {src_dir}/scripts/roobench.py server launch {server_name} {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, server_name=server_name, remote_config_dir=remote_config_dir)
-        if args['--verbose']:
+        if verbose:
             print cmd
         p = remote_call(host, cmd)
         tasks.append(p)
         SERVER_ID += 1
     wait(tasks)
     print "          ... Done."
-    
-    time.sleep(1)
-    
-    if args['--pause']:
-        raw_input("Press Enter to continue...")
 
-    ##### Run Client
-    
-    print "Start Client Workload..."
-    for host in hosts[:client_count]:
-        cmd = 'sudo nohup {src_dir}/scripts/roobench.py server start {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
-        if args['--verbose']:
-            print cmd
-        p = remote_call(host, cmd)
-        tasks.append(p)
-    wait(tasks)
-    print "          ... Done."
-    
-    time.sleep(4)
-    
-    ##### Dump stats
-    SERVER_ID=1
-    print "Dump stats [begining]..."
-    for host in hosts:
-        cmd = 'sudo nohup {src_dir}/scripts/roobench.py server stats {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
-        if args['--verbose']:
-            print cmd
-        p = remote_call(host, cmd)
-        tasks.append(p)
-        SERVER_ID += 1
-    wait(tasks)
+def start_workload(start_hosts, start_delay, src_dir, remote_config_dir, verbose):
+    tasks = []
+
+    # All nodes start at the same instant of a common future time, corrected
+    # for the offset of each node's clock, so that the skew of the ssh
+    # fan-out does not skew the start.
+    print "Estimate clock offsets..."
+    offsets = {}
+    for host in start_hosts:
+        offsets[host] = clock_offset(host)
+        if verbose:
+            print "{}: {:+.6f}s".format(host, offsets[host])
     print "          ... Done."
-    
-    time.sleep(10)
 
-    ##### Dump stats
-    SERVER_ID=1
-    print "Dump stats [end]..."
-    for host in hosts:
-        cmd = 'sudo nohup {src_dir}/scripts/roobench.py server stats {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
-        if args['--verbose']:
+    print "Start Client Workload..."
+    start_time = time.time() + start_delay
+    for host in start_hosts:
+        cmd = 'sudo nohup {src_dir}/scripts/roobench.py server start --at={at:.6f} {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, at=start_time + offsets[host], remote_config_dir=remote_config_dir)
+        if verbose:
             print cmd
         p = remote_call(host, cmd)
         tasks.append(p)
-        SERVER_ID += 1
     wait(tasks)
+    if time.time() > start_time:
+        print "Start time passed before all hosts were scheduled; increase --start-delay"
+    time.sleep(max(0, start_time - time.time()))
     print "          ... Done."
-    
-    time.sleep(1)
-    
+
+def shutdown_servers(hosts, date_time, out_dir, src_dir, remote_config_dir, verbose):
+    tasks = []
+
     ##### Stop Servers
     SERVER_ID=1
     print "Stop Hosts..."
     for host in hosts:
         cmd = 'sudo {src_dir}/scripts/roobench.py server stop {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
-        if args['--verbose']:
+        if verbose:
             print cmd
         p = remote_call(host, cmd)
         tasks.append(p)
@@ -176,7 +170,7 @@ def main(args):
     print "Kill Hosts..."
     for host in hosts:
         p = remote_call(host, "sudo pkill -f server")
-        if args['--verbose']:
+        if verbose:
             print cmd
         tasks.append(p)
         SERVER_ID += 1
@@ -193,6 +187,86 @@ def main(args):
     wait(tasks)
     print "          ... Done."
 
+def main(args):
+    hosts, bin_dir, src_dir = read_config(args['<config>'])
+    remote_config_dir = '/shome/RooConfig'
+    date_time = datetime.now().strftime('%F-%H-%M-%S')
+    with open(os.path.expanduser(args["<bench_config>"])) as f:
+        bench_config = json.load(f)
+    client_count = bench_config['client_count']
+    if (args['--out'] is not None):
+        out_name = args['--out']
+    else:
+        out_name = date_time
+    out_dir = coordinator_setup(args['<log_dir>'],
+                      out_name,
+                      args['<server_config>'],
+                      args['<bench_config>'])
+    hosts = hosts[:bench_config['node_count']]
+
+    tasks = []
+
+    launch_servers(hosts, client_count, date_time, src_dir, remote_config_dir,
+                   args['--verbose'])
+
+    time.sleep(1)
+    
+    if args['--pause']:
+        raw_input("Press Enter to continue...")
+
+    ##### Run Client
+
+    # With self-timed windows every node starts its run and takes its own
+    # stats snapshots; server nodes ignore the client start.
+    windows = bench_config.get('windows')
+    if windows is not None:
+        start_hosts = hosts
+    else:
+        start_hosts = hosts[:client_count]
+
+    start_workload(start_hosts, float(args['--start-delay']), src_dir,
+                   remote_config_dir, args['--verbose'])
+
+    if windows is not None:
+        print "Wait for measurement windows..."
+        time.sleep(windows.get('warmup', 0) + windows.get('measurement', 0) + windows.get('cooldown', 0))
+        print "          ... Done."
+    else:
+        time.sleep(4)
+
+        ##### Dump stats
+        SERVER_ID=1
+        print "Dump stats [begining]..."
+        for host in hosts:
+            cmd = 'sudo nohup {src_dir}/scripts/roobench.py server stats {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
+            if args['--verbose']:
+                print cmd
+            p = remote_call(host, cmd)
+            tasks.append(p)
+            SERVER_ID += 1
+        wait(tasks)
+        print "          ... Done."
+
+        time.sleep(10)
+
+        ##### Dump stats
+        SERVER_ID=1
+        print "Dump stats [end]..."
+        for host in hosts:
+            cmd = 'sudo nohup {src_dir}/scripts/roobench.py server stats {remote_config_dir}/ServerConfig.json'.format(src_dir=src_dir, remote_config_dir=remote_config_dir)
+            if args['--verbose']:
+                print cmd
+            p = remote_call(host, cmd)
+            tasks.append(p)
+            SERVER_ID += 1
+        wait(tasks)
+        print "          ... Done."
+    
+    time.sleep(1)
+    
+    shutdown_servers(hosts, date_time, out_dir, src_dir, remote_config_dir,
+                     args['--verbose'])
+
 
 if __name__ == '__main__':
     args = docopt(__doc__)
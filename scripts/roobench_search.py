@@ -0,0 +1,209 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2020, Stanford University
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+
+"""
+Usage:
+    roobench.py search <config> <server_config> <bench_config> <log_dir> --target=<us> [options]
+
+Options:
+    -h, --help                Show this screen.
+    -t, --target=<us>         Latency target of the SLO in microseconds.
+    -P, --percentile=<p>      Latency percentile that must stay under the target [default: 99].
+    -l, --low=<ops>           Load of the first probe in ops/sec [default: 10000].
+    -H, --high=<ops>          Highest load to probe; 0 for no limit [default: 0].
+    -r, --precision=<frac>    Stop once the highest passing and the lowest
+                              failing load are within this fraction [default: 0.02].
+    -s, --settle-time=<sec>   Seconds each load runs before it is measured [default: 1].
+    -m, --probe-time=<sec>    Seconds each load is measured [default: 4].
+    -o, --out=<outdir>        Name of the output directory; defaults to a date string.
+    -d, --start-delay=<sec>   Seconds between scheduling the synchronized start
+                              and the start itself [default: 2].
+    -v, --verbose             Print out the commands before they are run.
+
+Searches for the highest load at which the given latency percentile stays
+under the target and no op is dropped or fails.  The load doubles from --low
+until a probe misses the SLO and is then narrowed down by bisection.  All
+probes run within a single benchmark run; the load of the client hosts is
+changed through their control sockets.
+"""
+
+import json
+import subprocess
+import time
+from datetime import datetime
+
+from roobench_run import (read_config, coordinator_setup, launch_servers,
+                          start_workload, shutdown_servers)
+
+def control(hosts, src_dir, remote_config_dir, request, arg=None,
+            percentile=None, verbose=False):
+    """
+    Send a control request to all hosts and return the responding nodes
+    keyed by node name.
+    """
+    cmd = 'sudo {src_dir}/scripts/roobench.py server control'.format(src_dir=src_dir)
+    if percentile is not None:
+        cmd += ' --percentiles={}'.format(percentile)
+    cmd += ' {remote_config_dir}/ServerConfig.json {request}'.format(remote_config_dir=remote_config_dir, request=request)
+    if arg is not None:
+        cmd += ' {}'.format(arg)
+    if verbose:
+        print cmd
+    tasks = []
+    for host in hosts:
+        p = subprocess.Popen('ssh {host} "{cmd}"'.format(host=host, cmd=cmd),
+                             shell=True, stdout=subprocess.PIPE)
+        tasks.append((host, p))
+    nodes = {}
+    for host, p in tasks:
+        output = p.communicate()[0]
+        try:
+            response = json.loads(output)
+        except ValueError:
+            raise RuntimeError('{}: {} failed: {}'.format(host, request, output.strip()))
+        if not response['ok']:
+            raise RuntimeError('{}: {} failed: {}'.format(host, request, response['error']))
+        nodes.update(response.get('nodes', {}))
+    return nodes
+
+def probe(load, hosts, args, src_dir, remote_config_dir):
+    """
+    Run the given load and return the measurements of its probe.
+    """
+    percentile = float(args['--percentile'])
+    verbose = args['--verbose']
+    control(hosts, src_dir, remote_config_dir, 'set-load', load, verbose=verbose)
+    time.sleep(float(args['--settle-time']))
+
+    # Measure the ops completed between the two latency requests.
+    control(hosts, src_dir, remote_config_dir, 'latency',
+            percentile=percentile, verbose=verbose)
+    before = control(hosts, src_dir, remote_config_dir, 'status', verbose=verbose)
+    time.sleep(float(args['--probe-time']))
+    latency = control(hosts, src_dir, remote_config_dir, 'latency',
+                      percentile=percentile, verbose=verbose)
+    after = control(hosts, src_dir, remote_config_dir, 'status', verbose=verbose)
+
+    result = {'load': load, 'count': 0, 'failures': 0, 'drops': 0,
+              'latency': None}
+    for name, status in after.items():
+        if not status.get('client'):
+            continue
+        for key in ['count', 'failures', 'drops']:
+            result[key] += status[key] - before[name][key]
+        for p in latency[name]['percentiles']:
+            if 'latency' not in p:
+                continue
+            # The slowest client decides whether the SLO holds.
+            if result['latency'] is None or p['latency'] > result['latency']:
+                result['latency'] = p['latency']
+    target_ns = float(args['--target']) * 1000
+    result['passed'] = (result['count'] > 0 and
+                        result['latency'] is not None and
+                        result['latency'] <= target_ns and
+                        result['failures'] == 0 and
+                        result['drops'] == 0)
+    print "{:>12.0f} ops/sec: p{} {} ns, {} ops, {} failures, {} drops -> {}".format(
+        load, args['--percentile'], result['latency'], result['count'],
+        result['failures'], result['drops'],
+        'pass' if result['passed'] else 'fail')
+    return result
+
+def search(hosts, args, src_dir, remote_config_dir):
+    """
+    Return the highest passing load (None if even the lowest load fails) and
+    the results of all probes.
+    """
+    high = float(args['--high'])
+    precision = float(args['--precision'])
+    probes = []
+
+    # Ramp up until the SLO breaks.
+    passed = None
+    failed = None
+    load = float(args['--low'])
+    while True:
+        result = probe(load, hosts, args, src_dir, remote_config_dir)
+        probes.append(result)
+        if not result['passed']:
+            failed = load
+            break
+        passed = load
+        if high > 0 and load >= high:
+            break
+        load = load * 2
+        if high > 0:
+            load = min(load, high)
+    if passed is None or failed is None:
+        return passed, probes
+
+    # Back off by bisecting between the highest passing and the lowest
+    # failing load.
+    while failed - passed > precision * passed:
+        load = (passed + failed) / 2
+        result = probe(load, hosts, args, src_dir, remote_config_dir)
+        probes.append(result)
+        if result['passed']:
+            passed = load
+        else:
+            failed = load
+    return passed, probes
+
+def main(args):
+    hosts, bin_dir, src_dir = read_config(args['<config>'])
+    remote_config_dir = '/shome/RooConfig'
+    date_time = datetime.now().strftime('%F-%H-%M-%S')
+    with open(args["<bench_config>"]) as f:
+        bench_config = json.load(f)
+    if bench_config.get('windows') is not None:
+        exit("The search needs a bench config without measurement windows.")
+    if bench_config.get('closed_loop', {}).get('concurrency', 0) > 0:
+        exit("The search needs an open-loop bench config.")
+    client_count = bench_config['client_count']
+    if (args['--out'] is not None):
+        out_name = args['--out']
+    else:
+        out_name = date_time
+    out_dir = coordinator_setup(args['<log_dir>'],
+                      out_name,
+                      args['<server_config>'],
+                      args['<bench_config>'])
+    hosts = hosts[:bench_config['node_count']]
+    client_hosts = hosts[:client_count]
+
+    launch_servers(hosts, client_count, date_time, src_dir, remote_config_dir,
+                   args['--verbose'])
+    time.sleep(1)
+    start_workload(client_hosts, float(args['--start-delay']), src_dir,
+                   remote_config_dir, args['--verbose'])
+
+    print "Search maximum sustainable load..."
+    try:
+        max_load, probes = search(client_hosts, args, src_dir,
+                                  remote_config_dir)
+    finally:
+        time.sleep(1)
+        shutdown_servers(hosts, date_time, out_dir, src_dir,
+                         remote_config_dir, args['--verbose'])
+
+    if max_load is None:
+        print "No load meets the SLO."
+    else:
+        print "Maximum sustainable load: {:.0f} ops/sec".format(max_load)
+    with open(out_dir + '/search.json', 'w') as f:
+        json.dump({'percentile': float(args['--percentile']),
+                   'target_us': float(args['--target']),
+                   'max_load': max_load,
+                   'probes': probes}, f, indent=4)
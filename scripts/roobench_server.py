@@ -21,9 +21,16 @@ Usage:
     roobench.py server stats [options] <config_file>
     roobench.py server stop [options] <config_file>
     roobench.py server kill [options] <config_file>
+    roobench.py server control [options] <config_file> <request> [<arg>]
 
 Options:
     -h, --help          Show this screen.
+    --at=<time>         Start the run at the given wall-clock time in seconds
+                        since the epoch instead of immediately.
+    --metrics=<addr>    Serve the server's stats over HTTP in the Prometheus
+                        text format at [<host>:]<port> (launch only).
+    --percentiles=<p>   Comma-separated percentiles reported by the latency
+                        request [default: 50,99].
 
 Available commands are:
     launch      Setup the benchmark server
@@ -31,6 +38,9 @@ Available commands are:
     stats       Dump the benchmark statistics
     stop        Stop the benchmark server
     kill        Kill the benchmark server
+    control     Send a request to the benchmark server's control socket; the
+                request is one of start, stop, snapshot [<name>],
+                set-load <ops>, status, latency or reload [<bench_config>]
 """
 
 from docopt import docopt
@@ -38,6 +48,20 @@ import subprocess
 import json
 import os
 import signal
+import socket
+
+def send_request(server_info, request):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(server_info["control"])
+    s.sendall(json.dumps(request) + '\n')
+    response = ''
+    while not response.endswith('\n'):
+        data = s.recv(4096)
+        if not data:
+            break
+        response += data
+    s.close()
+    return response.strip()
 
 def main(args):
     with open(os.path.expanduser(args["<config_file>"])) as f:
@@ -62,14 +86,17 @@ def main(args):
         server_name = args["<server_name>"]
         outlog = open(output_dir + '/' + server_name + '.out.log', 'w')
         errlog = open(output_dir + '/' + server_name + '.err.log', 'w')
-        p = subprocess.Popen([server_bin,
-                              server_name,
-                              num_threads,
-                              bench_config,
-                              output_dir],
+        server_args = [server_bin]
+        if args['--metrics'] is not None:
+            server_args.append('--metrics=' + args['--metrics'])
+        p = subprocess.Popen(server_args + [server_name,
+                                            num_threads,
+                                            bench_config,
+                                            output_dir],
                              stdout = outlog,
                              stderr = errlog)
         server_info['pid'] = p.pid
+        server_info['control'] = output_dir + '/' + server_name + '.sock'
         with open(server_info_path, 'w') as f:
             json.dump(server_info, f)
     elif args['start']:
@@ -78,11 +105,19 @@ def main(args):
         except NameError:
             print("No server info available (server not loaded?)")
         else:
-            pid = server_info["pid"]
-            try:
-                os.kill(pid, signal.SIGUSR1)
-            except OSError as error:
-                print(error)
+            if args['--at'] is not None:
+                # Scheduled starts need the control socket.
+                request = {"command": "start", "at": float(args['--at'])}
+                try:
+                    print(send_request(server_info, request))
+                except (KeyError, socket.error) as error:
+                    print(error)
+            else:
+                pid = server_info["pid"]
+                try:
+                    os.kill(pid, signal.SIGUSR1)
+                except OSError as error:
+                    print(error)
     elif args['stats']:
         try:
             server_info
@@ -117,6 +152,27 @@ def main(args):
             except OSError as error:
                 print(error)
 
+    elif args['control']:
+        try:
+            server_info
+        except NameError:
+            print("No server info available (server not loaded?)")
+        else:
+            request = {"command": args['<request>']}
+            if args['<request>'] == 'latency':
+                request["percentiles"] = [float(p) for p in args['--percentiles'].split(',')]
+            if args['<arg>'] is not None:
+                if args['<request>'] == 'snapshot':
+                    request["name"] = args['<arg>']
+                elif args['<request>'] == 'set-load':
+                    request["load"] = float(args['<arg>'])
+                elif args['<request>'] == 'reload':
+                    request["path"] = os.path.abspath(os.path.expanduser(args['<arg>']))
+            try:
+                print(send_request(server_info, request))
+            except (KeyError, socket.error) as error:
+                print(error)
+
 if __name__ == '__main__':
     args = docopt(__doc__)
     main(args)
@@ -20,31 +20,123 @@ Usage:
 
 Options:
     -h, --help              Show this screen.
+    -i, --intervals         Output the time series of each node (not part of
+                            the default output)
     -l, --latency           Output Latency Stats
     -n, --network           Output Network Usage Stats
     -c, --cpu               Output CPU Usage Stats
+    -D, --peers             Output Per-Server Load and Latency Stats
+    -H, --threads           Output Per-Thread CPU and Socket Poll Stats
     -p, --packet            Output Packet Stats
+    -P, --phases            Output Per-Phase Latency Stats
     -s, --summary           Output a stats summary
+    -S, --steps             Output Load Step Stats
     -t, --task              Output Task Stats
+    -T, --task-latency      Output Task Queueing and Service Time Stats
 """
 
 import glob
+import mmap
 import os
 import json
+import struct
 import numpy as np
 
 np.seterr(divide = 'ignore') 
 
+# Binary stats format written by the benchmark's StatsWriter.
+STATS_MAGIC = b'RBSTATS\0'
+STATS_VERSION = 1
+(STATS_END, STATS_UINT, STATS_DOUBLE, STATS_STRING, STATS_JSON,
+ STATS_HISTOGRAM) = range(6)
+
+def set_pointer(document, pointer, value):
+    """
+    Store a value in the document at the given JSON pointer, creating the
+    objects and lists on the way.
+    """
+    tokens = pointer.split('/')[1:]
+    node = document
+    for i, token in enumerate(tokens):
+        if isinstance(node, list):
+            token = int(token)
+            node.extend([None] * (token + 1 - len(node)))
+        elif token not in node:
+            node[token] = None
+        if i == len(tokens) - 1:
+            node[token] = value
+        else:
+            if node[token] is None:
+                node[token] = [] if tokens[i + 1].isdigit() else {}
+            node = node[token]
+
+def read_binary_stats(path, partial=False):
+    """
+    Read a binary stats dump into the document the equivalent JSON dump
+    would hold.  A dump that was cut short is an error unless partial is set,
+    in which case the records written so far are returned.
+    """
+    with open(path, 'rb') as f:
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    try:
+        magic, version, _ = struct.unpack_from('<8sII', data, 0)
+        if magic != STATS_MAGIC:
+            raise ValueError('%s is not a stats dump' % path)
+        if version != STATS_VERSION:
+            raise ValueError('%s has unsupported version %d' % (path, version))
+        document = {}
+        offset = 16
+        complete = False
+        while offset + 16 <= len(data):
+            record_type, pointer_length, length = struct.unpack_from('<IIQ', data, offset)
+            offset += 16
+            pointer = data[offset:offset + pointer_length].decode('utf-8')
+            offset += (pointer_length + 7) & ~7
+            if record_type == STATS_END:
+                complete = True
+                break
+            elif record_type == STATS_UINT:
+                value = struct.unpack_from('<Q', data, offset)[0]
+            elif record_type == STATS_DOUBLE:
+                value = struct.unpack_from('<d', data, offset)[0]
+            elif record_type == STATS_STRING:
+                value = data[offset:offset + length].decode('utf-8')
+            elif record_type == STATS_JSON:
+                value = json.loads(data[offset:offset + length].decode('utf-8'))
+            elif record_type == STATS_HISTOGRAM:
+                sub_bucket_bits, max_value_bits, count, bucket_count = struct.unpack_from('<IIQQ', data, offset)
+                value = {"sub_bucket_bits": sub_bucket_bits,
+                         "max_value_bits": max_value_bits,
+                         "count": count,
+                         "buckets": list(struct.unpack_from('<%dQ' % (2 * bucket_count), data, offset + 24))}
+            else:
+                value = None
+            if value is not None:
+                set_pointer(document, pointer, value)
+            offset += (length + 7) & ~7
+    finally:
+        data.close()
+    if not complete and not partial:
+        raise ValueError('%s is truncated' % path)
+    return document
+
+def load_stats(path):
+    """
+    Load the stats dump with the given path (without extension) from its
+    binary file, or from its JSON file for runs that predate the binary
+    format.
+    """
+    if os.path.exists(path + '.bin'):
+        return read_binary_stats(path + '.bin')
+    with open(path + '.json') as f:
+        return json.load(f)
+
 def stat_diff(stat_name, start_data, end_data):
     return end_data[stat_name] - start_data[stat_name];
 
 def get_transport_stats(data_dir, server_name):
-    start_data_file = data_dir + '/' + server_name + '_transport_stats_0.json'
-    end_data_file = data_dir + '/' + server_name + '_transport_stats_1.json'
-    with open(start_data_file) as f:
-        start_data = json.load(f)
-    with open(end_data_file) as f:
-        end_data = json.load(f)
+    start_data = load_stats(data_dir + '/' + server_name + '_transport_stats_0')
+    end_data = load_stats(data_dir + '/' + server_name + '_transport_stats_1')
     cps = end_data["cycles_per_second"]
 
     data = {}
@@ -77,61 +169,182 @@ def get_transport_stats(data_dir, server_name):
 
     return data
 
+def load_histogram(histogram):
+    """
+    Return the counts of a serialized latency histogram keyed by the value in
+    the middle of their bucket.
+    """
+    if histogram is None:
+        return {}
+    sub_bucket_count = 1 << histogram["sub_bucket_bits"]
+    sub_bucket_half = sub_bucket_count / 2
+    buckets = histogram["buckets"]
+    counts = {}
+    for i in range(0, len(buckets), 2):
+        index = buckets[i]
+        if index < sub_bucket_count:
+            value = index
+        else:
+            shift = (index - sub_bucket_count) / sub_bucket_half + 1
+            sub_bucket = (index - sub_bucket_count) % sub_bucket_half + sub_bucket_half
+            lowest = sub_bucket << shift
+            highest = ((sub_bucket + 1) << shift) - 1
+            value = lowest + (highest - lowest) / 2
+        counts[value] = buckets[i + 1]
+    return counts
+
+def histogram_diff(end, start):
+    return {value: count - start.get(value, 0) for value, count in end.items() if count > start.get(value, 0)}
+
+def histogram_merge(histograms):
+    merged = {}
+    for histogram in histograms:
+        for value, count in histogram.items():
+            merged[value] = merged.get(value, 0) + count
+    return merged
+
+def histogram_count(histogram):
+    return sum(histogram.values())
+
 def get_bench_stats(data_dir, server_name):
-    start_data_file = data_dir + '/' + server_name + '_bench_stats_0.json'
-    end_data_file = data_dir + '/' + server_name + '_bench_stats_1.json'
-    with open(start_data_file) as f:
-        start_data = json.load(f)
-    with open(end_data_file) as f:
-        end_data = json.load(f)
+    start_data = load_stats(data_dir + '/' + server_name + '_bench_stats_0')
+    end_data = load_stats(data_dir + '/' + server_name + '_bench_stats_1')
     cps = end_data["cycles_per_second"]
 
-    latencies = []
-    if end_data["client_stats"]["count"] > len(end_data["client_stats"]["latencies"]):
-        end_count = end_data["client_stats"]["count"]
-        start_count = start_data["client_stats"]["count"]
-        max_count = len(end_data["client_stats"]["latencies"])
-        if end_count - start_count >= max_count:
-            latencies = end_data["client_stats"]["latencies"]
-        else:
-            end_index = end_count % max_count
-            start_index = start_count % max_count 
-            if start_index <= end_index:
-                latencies = end_data["client_stats"]["latencies"][start_index:end_index]
-            else:
-                latencies = end_data["client_stats"]["latencies"][start_index:] + end_data["client_stats"]["latencies"][:end_index]
-    else:
-        warmup_count = len(start_data["client_stats"]["latencies"])
-        latencies = end_data["client_stats"]["latencies"][warmup_count:]
+    start_client = start_data["client_stats"]
+    end_client = end_data["client_stats"]
+    latency = histogram_diff(load_histogram(end_client.get("latency")),
+                             load_histogram(start_client.get("latency")))
+
+    steps = []
+    for end_step in end_data["client_stats"].get("steps", []):
+        start_step = start_data["client_stats"]["steps"][end_step["index"]]
+        steps.append({"load": end_step["load"],
+                      "duration": end_step["duration"],
+                      "count": end_step["count"] - start_step["count"],
+                      "failures": end_step["failures"] - start_step["failures"],
+                      "drops": end_step["drops"] - start_step["drops"],
+                      "offered": end_step.get("offered", 0) - start_step.get("offered", 0),
+                      "latency": histogram_diff(load_histogram(end_step.get("latency")),
+                                                load_histogram(start_step.get("latency")))})
+
+    start_peers = {peer["name"]: peer for peer in start_client.get("peers", [])}
+    peers = {}
+    for end_peer in end_client.get("peers", []):
+        start_peer = start_peers[end_peer["name"]]
+        peers[end_peer["name"]] = {
+            "address": end_peer["address"],
+            "sent": end_peer["sent"] - start_peer["sent"],
+            "completed": end_peer.get("completed", 0) - start_peer.get("completed", 0),
+            "failures": end_peer.get("failures", 0) - start_peer.get("failures", 0),
+            "latency": histogram_diff(load_histogram(end_peer["latency"]),
+                                      load_histogram(start_peer["latency"]))}
 
     start_task_stats = {task['id']: task['count'] for task in start_data['task_stats']}
     end_task_stats = {task['id']: task['count'] for task in end_data['task_stats']}
     task_stats = {key: end_task_stats[key] - start_task_stats[key] for key in start_task_stats}
+    start_tasks = {task['id']: task for task in start_data['task_stats']}
+    task_histograms = {}
+    for end_task in end_data['task_stats']:
+        start_task = start_tasks[end_task['id']]
+        task_histograms[end_task['id']] = {
+            key: histogram_diff(load_histogram(end_task.get(key)), load_histogram(start_task.get(key)))
+            for key in ('queueing', 'service', 'request_bytes', 'response_bytes')}
+
+    # Per-thread CPU accounting; dumps that predate it have none.
+    placement = end_data.get("placement") or []
+    start_threads = start_data.get("thread_stats", [])
+    threads = []
+    for end_thread in end_data.get("thread_stats", []):
+        start_thread = start_threads[end_thread["thread"]]
+        thread = {key: end_thread[key] - start_thread[key]
+                  for key in ('total_cycles', 'client_active_cycles', 'server_active_cycles',
+                              'idle_poll_cycles', 'polls')}
+        thread["thread"] = end_thread["thread"]
+        thread["role"] = placement[end_thread["thread"]]["role"] if end_thread["thread"] < len(placement) else "-"
+        thread["poll_gap"] = histogram_diff(load_histogram(end_thread.get("poll_gap")),
+                                            load_histogram(start_thread.get("poll_gap")))
+        threads.append(thread)
 
     data = {}
 
     data["elapsed_time"] = stat_diff("timestamp", start_data, end_data) / cps
     data["cycles_per_second"] = cps
     data["active_cycles"] = stat_diff("active_cycles", start_data, end_data)
-    data["client_latencies"] = latencies
+    data["client_latency"] = latency
+    data["client_phases"] = [histogram_diff(load_histogram(end_phase["latency"]),
+                                            load_histogram(start_client["phases"][end_phase["index"]]["latency"]))
+                             for end_phase in end_client.get("phases", [])]
+    data["client_steps"] = steps
+    data["client_peers"] = peers
     data["client_count"] = end_data["client_stats"]["count"] - start_data["client_stats"]["count"]
     data["client_failures"] = end_data["client_stats"]["failures"] - start_data["client_stats"]["failures"]
     data["client_drops"] = end_data["client_stats"]["drops"] - start_data["client_stats"]["drops"]
+    data["client_offered"] = end_data["client_stats"].get("offered", 0) - start_data["client_stats"].get("offered", 0)
+    data["client_delayed"] = end_data["client_stats"].get("delayed", 0) - start_data["client_stats"].get("delayed", 0)
+    data["client_lag_cycles"] = end_data["client_stats"].get("lag_cycles", 0) - start_data["client_stats"].get("lag_cycles", 0)
     data["task_stats"] = task_stats
+    data["task_histograms"] = task_histograms
+    data["threads"] = threads
 
     return data
 
+def get_timeseries(data_dir, server_name):
+    """
+    Return the stats of each interval between two samples of the node's time
+    series, or None if the node did not sample its stats.
+    """
+    path = data_dir + '/' + server_name + '_timeseries.bin'
+    if not os.path.exists(path):
+        return None
+    # The time series of a node that was killed lacks its end record.
+    series = read_binary_stats(path, partial=True)
+    cps = series["cycles_per_second"]
+    samples = [sample for sample in series.get("samples", []) if sample is not None]
+    intervals = []
+    for start, end in zip(samples, samples[1:]):
+        elapsed = (end["timestamp"] - start["timestamp"]) / cps
+        transport_cps = end["transport"]["cycles_per_second"]
+        intervals.append({
+            "time": (end["timestamp"] - samples[0]["timestamp"]) / cps,
+            "count": end["client_stats"]["count"] - start["client_stats"]["count"],
+            "drops": end["client_stats"]["drops"] - start["client_stats"]["drops"],
+            "throughput": (end["client_stats"]["count"] - start["client_stats"]["count"]) / elapsed / 1000.0,
+            # Each sample holds the latency of the ops completed since the
+            # previous sample.
+            "latency": load_histogram(end["latency"]),
+            "cpu_bench": (end["active_cycles"] - start["active_cycles"]) / (cps * elapsed),
+            "cpu_poll": (end["transport"]["active_cycles"] - start["transport"]["active_cycles"]) / (transport_cps * elapsed)})
+    return intervals
+
+def percentile(histogram, drops, p):
+    """
+    Return the p-th quantile of the latency histogram where dropped ops count
+    as infinitely slow; otherwise an overloaded client would report the
+    latency of the few ops it still managed to issue.
+    """
+    n = histogram_count(histogram) + drops
+    if n == 0:
+        return 0
+    index = int(p * n)
+    seen = 0
+    for value in sorted(histogram):
+        seen += histogram[value]
+        if seen > index:
+            return value
+    return float('inf')
+
 def get_latencies(client_names, bench_stats):
-    latencies = []
-    for name in client_names:
-        latencies += bench_stats[name]["client_latencies"]
-    latencies.sort()
-    return latencies
+    return histogram_merge([bench_stats[name]["client_latency"] for name in client_names])
 
 def print_summary(client_names, server_names, bench_stats, transport_stats):
     client_count = 0
     client_failures = 0
     client_drops = 0
+    client_offered = 0
+    client_delayed = 0
+    client_lag = 0.0
+    offered_load = 0.0
     throughput = 0.0
     cpu_util_bench = 0.0
     cpu_util_fg = 0.0
@@ -140,6 +353,10 @@ def print_summary(client_names, server_names, bench_stats, transport_stats):
         client_count += bench_stats[name]["client_count"]
         client_failures += bench_stats[name]["client_failures"]
         client_drops += bench_stats[name]["client_drops"]
+        client_offered += bench_stats[name]["client_offered"]
+        client_delayed += bench_stats[name]["client_delayed"]
+        client_lag += bench_stats[name]["client_lag_cycles"] / bench_stats[name]["cycles_per_second"]
+        offered_load += (bench_stats[name]["client_offered"] / bench_stats[name]["elapsed_time"]) / 1000.0
         throughput += (bench_stats[name]["client_count"] / bench_stats[name]["elapsed_time"]) / 1000.0
         _cps = bench_stats[name]["cycles_per_second"]
         _duration = bench_stats[name]["elapsed_time"]
@@ -148,38 +365,116 @@ def print_summary(client_names, server_names, bench_stats, transport_stats):
         _duration = transport_stats[name]["elapsed_time"]
         cpu_util_fg += transport_stats[name]["api_cycles"] / (_cps * _duration)
         cpu_util_bg += transport_stats[name]["active_cycles"] / (_cps * _duration)
-    latency = 0
     latencies = get_latencies(client_names, bench_stats)
-    if len(latencies) > 0:
-        latency = latencies[int(0.5 * len(latencies))] / 1000.0
+    latency = percentile(latencies, client_drops, 0.5) / 1000.0
+    latency_99 = percentile(latencies, client_drops, 0.99) / 1000.0
+    issued = client_offered - client_drops
+    issue_lag = client_lag / issued * 1e6 if issued > 0 else 0.0
 
     print "Summary Statistics"
     print "------------------"
     print "Num Completed: %8d" % client_count
     print "   Num Failed: %8d" % client_failures
     print "  Num Dropped: %8d" % client_drops
+    # Dropped ops were offered but never issued; the load actually offered
+    # falls short of the configured load by the deficit.
+    print " Offered Load: %8.3f kops" % offered_load
+    print " Load Deficit: %8.3f %%" % (100.0 * client_drops / client_offered if client_offered > 0 else 0.0)
+    print "  Num Delayed: %8d" % client_delayed
     print "Latency [med]: %8.3f us" % latency
+    print "Latency [99%%]: %8.3f us" % latency_99
+    print "    Issue Lag: %8.3f us [avg]" % issue_lag
     print "   Throughput: %8.3f kops" % throughput
     print "     CPU Util: %8.3f cores [%6.2f / %6.2f / %6.2f](bench, api, poll)" % (cpu_util_bench + cpu_util_bg, cpu_util_bench - cpu_util_fg, cpu_util_fg, cpu_util_bg)
     pass
 
 def print_latency(bench_stats, client_names):
     latencies = get_latencies(client_names, bench_stats)
-    count = len(latencies)
+    count = histogram_count(latencies)
     print "Client Latency (%9d samples)" % count
     print "------------------------------------------------------------"
     if (count < 1):
         print "No data"
     else:
-        latency_min = latencies[0] / 1000.0
-        latency_25 = latencies[int(0.25 * len(latencies))] / 1000.0
-        latency_med = latencies[int(0.5 * len(latencies))] / 1000.0
-        latency_75 = latencies[int(0.75 * len(latencies))] / 1000.0
-        latency_90 = latencies[int(0.9 * len(latencies))] / 1000.0
-        latency_99 = latencies[int(0.99 * len(latencies))] / 1000.0
+        latency_min = min(latencies) / 1000.0
+        latency_25 = percentile(latencies, 0, 0.25) / 1000.0
+        latency_med = percentile(latencies, 0, 0.5) / 1000.0
+        latency_75 = percentile(latencies, 0, 0.75) / 1000.0
+        latency_90 = percentile(latencies, 0, 0.9) / 1000.0
+        latency_99 = percentile(latencies, 0, 0.99) / 1000.0
         print " Med (us)  Min (us)  25% (us)  75% (us)  90% (us)  99% (us) "
         print "%8.3f  %8.3f  %8.3f  %8.3f  %8.3f  %8.3f" % (latency_med, latency_min, latency_25, latency_75, latency_90, latency_99)
 
+def print_phase_stats(bench_stats, client_names):
+    phase_count = len(bench_stats[client_names[0]]["client_phases"]) if client_names else 0
+    print "Client Phase Latency"
+    print "------------------------------------------------------------"
+    if phase_count < 1:
+        print "No data"
+        return
+    print "Phase    Samples  Med (us)  90% (us)  99% (us)  99.9% (us)"
+    def print_phase_entry(label, latencies):
+        print "%5s  %9d  %8.3f  %8.3f  %8.3f  %10.3f" % (label, histogram_count(latencies),
+            percentile(latencies, 0, 0.5) / 1000.0, percentile(latencies, 0, 0.9) / 1000.0,
+            percentile(latencies, 0, 0.99) / 1000.0, percentile(latencies, 0, 0.999) / 1000.0)
+    for index in range(phase_count):
+        print_phase_entry(str(index), histogram_merge([bench_stats[name]["client_phases"][index] for name in client_names]))
+    print_phase_entry("Total", get_latencies(client_names, bench_stats))
+
+def print_step_stats(bench_stats, client_names):
+    steps = bench_stats[client_names[0]]["client_steps"] if client_names else []
+    print "Load Steps"
+    print "------------------------------------------------------------------------"
+    if len(steps) < 1:
+        print "No data"
+        return
+    print " Step  Load (ops)  Tput (kops)  Completed  Failed  Dropped  Deficit  Med (us)  99% (us)"
+    for index, step in enumerate(steps):
+        count = 0
+        failures = 0
+        drops = 0
+        offered = 0
+        histograms = []
+        for name in client_names:
+            client_step = bench_stats[name]["client_steps"][index]
+            count += client_step["count"]
+            failures += client_step["failures"]
+            drops += client_step["drops"]
+            offered += client_step.get("offered", 0)
+            histograms.append(client_step["latency"])
+        latencies = histogram_merge(histograms)
+        duration = step["duration"]
+        if duration <= 0:
+            duration = bench_stats[client_names[0]]["elapsed_time"]
+        latency_med = percentile(latencies, drops, 0.5) / 1000.0
+        latency_99 = percentile(latencies, drops, 0.99) / 1000.0
+        deficit = 100.0 * drops / offered if offered > 0 else 0.0
+        print "%5d  %10.1f  %11.3f  %9d  %6d  %7d  %6.2f%%  %8.3f  %8.3f" % (index, step["load"], np.divide(count, duration) / 1000.0, count, failures, drops, deficit, latency_med, latency_99)
+
+def print_peer_stats(bench_stats, client_names):
+    peers = {}
+    for name in client_names:
+        for peer_name, peer in bench_stats[name]["client_peers"].items():
+            peers.setdefault(peer_name, []).append(peer)
+    print "Per-Server Stats"
+    print "------------------------------------------------------------------------------------"
+    if len(peers) < 1:
+        print "No data"
+        return
+    # A server's share of the requests shows load imbalance; its latency
+    # relative to the other servers shows stragglers.
+    total_sent = sum(peer["sent"] for entries in peers.values() for peer in entries)
+    print "      Server               Address     Sent   Share  Failed  Med (us)  99% (us)  99.9% (us)"
+    for peer_name in sorted(peers):
+        entries = peers[peer_name]
+        sent = sum(peer["sent"] for peer in entries)
+        failures = sum(peer["failures"] for peer in entries)
+        latencies = histogram_merge([peer["latency"] for peer in entries])
+        share = 100.0 * sent / total_sent if total_sent > 0 else 0.0
+        print "%12s  %20s  %7d  %5.1f%%  %6d  %8.3f  %8.3f  %10.3f" % (peer_name, entries[0]["address"], sent, share, failures,
+            percentile(latencies, 0, 0.5) / 1000.0, percentile(latencies, 0, 0.99) / 1000.0,
+            percentile(latencies, 0, 0.999) / 1000.0)
+
 def print_net_usage(client_names, server_names, bench_stats, transport_stats):
     print "Network Usage Statistics:"
     print "-------------------------"
@@ -356,6 +651,65 @@ def print_task_stats(host_names, bench_stats):
         stats_line += " %7d" % stat 
     print stats_line
 
+def print_task_latency(host_names, bench_stats):
+    print "Task Queueing and Service Time"
+    print "------------------------------------------------------------------------------------"
+    task_ids = sorted(bench_stats[host_names[0]]["task_histograms"]) if host_names else []
+    if len(task_ids) < 1:
+        print "No data"
+        return
+    # Queueing is the time a request waited in the server's socket before it
+    # was received; it is not recorded by the DPC benchmark.
+    print " Task    Samples  Queue Med (us)  Queue 99% (us)  Svc Med (us)  Svc 99% (us)  Req (B)  Resp (B)"
+    for task_id in task_ids:
+        histograms = [bench_stats[name]["task_histograms"][task_id] for name in host_names]
+        queueing = histogram_merge([h["queueing"] for h in histograms])
+        service = histogram_merge([h["service"] for h in histograms])
+        request_bytes = histogram_merge([h["request_bytes"] for h in histograms])
+        response_bytes = histogram_merge([h["response_bytes"] for h in histograms])
+        print "%5d  %9d  %14.3f  %14.3f  %12.3f  %12.3f  %7d  %8d" % (task_id, histogram_count(service),
+            percentile(queueing, 0, 0.5) / 1000.0, percentile(queueing, 0, 0.99) / 1000.0,
+            percentile(service, 0, 0.5) / 1000.0, percentile(service, 0, 0.99) / 1000.0,
+            percentile(request_bytes, 0, 0.5), percentile(response_bytes, 0, 0.5))
+
+def print_thread_stats(host_names, bench_stats):
+    print "Per-Thread CPU and Socket Poll Statistics"
+    print "------------------------------------------------------------------------------------------------"
+    if not any(bench_stats[name]["threads"] for name in host_names):
+        print "No data"
+        return
+    # Busy is the share of the thread's cycles spent in loop iterations that
+    # found work, including the socket polls of those iterations; the poll gap
+    # is the time between two successive polls of the socket by the thread.
+    print "     Host  Thread  Role     Busy (%)  Client (%)  Server (%)  Polls (k/s)  Gap Med (us)  Gap 99% (us)"
+    for host_name in host_names:
+        elapsed = bench_stats[host_name]["elapsed_time"]
+        for thread in bench_stats[host_name]["threads"]:
+            total = float(thread["total_cycles"])
+            print "%9s  %6d  %-7s  %8.2f  %10.2f  %10.2f  %11.3f  %12.3f  %12.3f" % (host_name, thread["thread"],
+                thread["role"], np.divide(100 * (total - thread["idle_poll_cycles"]), total),
+                np.divide(100 * thread["client_active_cycles"], total),
+                np.divide(100 * thread["server_active_cycles"], total),
+                np.divide(thread["polls"], 1000 * elapsed),
+                percentile(thread["poll_gap"], 0, 0.5) / 1000.0, percentile(thread["poll_gap"], 0, 0.99) / 1000.0)
+
+def print_timeseries(data_dir, host_names):
+    for host_name in host_names:
+        intervals = get_timeseries(data_dir, host_name)
+        print "Time Series (%s)" % host_name
+        print "------------------------------------------------------------------------"
+        if not intervals:
+            print "No data"
+            print ""
+            continue
+        print " Time (s)  Tput (kops)  Dropped  Med (us)  99% (us)  CPU (cores) [bench / poll]"
+        for interval in intervals:
+            latencies = interval["latency"]
+            print "%9.3f  %11.3f  %7d  %8.3f  %8.3f  %6.2f / %6.2f" % (interval["time"], interval["throughput"],
+                interval["drops"], percentile(latencies, interval["drops"], 0.5) / 1000.0,
+                percentile(latencies, interval["drops"], 0.99) / 1000.0, interval["cpu_bench"], interval["cpu_poll"])
+        print ""
+
 def print_packet_stats(client_names, server_names, bench_stats, transport_stats):
     count = 0
     for client_name in client_names:
@@ -423,11 +777,15 @@ def print_packet_stats(client_names, server_names, bench_stats, transport_stats)
 def id_from_name(host_name):
     return int(host_name[7:])
 
+def get_host_names(data_dir, role):
+    # A dump has a binary file, a JSON file, or both.
+    names = set(os.path.basename(file).split('_bench_stats_1.')[0]
+                for file in glob.glob(data_dir + '/' + role + '*_bench_stats_1.*'))
+    return sorted(names, key=id_from_name)
+
 def main(args):
-    client_names =[os.path.basename(file)[:-19] for file in glob.glob(args['<data_dir>'] + '/client*_bench_stats_1.json')]
-    client_names.sort(key=id_from_name)
-    server_names =[os.path.basename(file)[:-19] for file in glob.glob(args['<data_dir>'] + '/server*_bench_stats_1.json')]
-    server_names.sort(key=id_from_name)
+    client_names = get_host_names(args['<data_dir>'], 'client')
+    server_names = get_host_names(args['<data_dir>'], 'server')
     host_names = client_names + server_names
 
     transport_stats = {}
@@ -438,7 +796,8 @@ def main(args):
         bench_stats[host_name] = get_bench_stats(args['<data_dir>'], host_name)
 
     flags_set = 0
-    for flag in ('--cpu', '--latency', '--network', '--packet', '--task', '--summary'):
+    for flag in ('--cpu', '--latency', '--network', '--packet', '--task', '--summary', '--steps', '--phases',
+                 '--task-latency', '--peers', '--threads', '--intervals'):
         if args[flag]:
             flags_set += 1
     if flags_set > 0:
@@ -453,7 +812,19 @@ def main(args):
     if (print_all or args['--latency']):
         print_latency(bench_stats, client_names)
         print ""
+
+    if (print_all or args['--phases']):
+        print_phase_stats(bench_stats, client_names)
+        print ""
+
+    if (print_all or args['--steps']):
+        print_step_stats(bench_stats, client_names)
+        print ""
     
+    if (print_all or args['--peers']):
+        print_peer_stats(bench_stats, client_names)
+        print ""
+
     if (print_all or args['--cpu']):
         print_cpu_usage_stats(client_names, server_names, bench_stats, transport_stats)
         print ""
@@ -469,6 +840,17 @@ def main(args):
         print_task_stats(host_names, bench_stats)
         print ""
 
+    if (print_all or args['--task-latency']):
+        print_task_latency(host_names, bench_stats)
+        print ""
+
+    if (print_all or args['--threads']):
+        print_thread_stats(host_names, bench_stats)
+        print ""
+
+    if args['--intervals']:
+        print_timeseries(args['<data_dir>'], host_names)
+
 if __name__ == '__main__':
     args = docopt(__doc__)
     main(args)
\ No newline at end of file
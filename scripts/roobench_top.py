@@ -0,0 +1,203 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2020, Stanford University
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+
+"""
+Usage:
+    roobench.py top [options] [<server_name>...]
+
+Options:
+    -h, --help              Show this screen.
+    -d, --delay=<s>         Seconds between two refreshes. [default: 1.0]
+    -n, --iterations=<n>    Number of refreshes; 0 refreshes until
+                            interrupted. [default: 0]
+
+Shows the live throughput, latency and CPU usage of the benchmark servers
+running on this host, as published in their live stats segments, without
+involving the servers.  Only the given servers are shown if any are named.
+"""
+
+from docopt import docopt
+import errno
+import glob
+import mmap
+import os
+import struct
+import sys
+import time
+
+from roobench_stats import histogram_diff, load_histogram, percentile
+
+SEGMENT_GLOB = '/dev/shm/roobench.*'
+MAGIC = 'RBLIVE\0\0'
+VERSION = 1
+
+# Layout of LiveStats::Header, LiveStats::Entry and LiveStats::HistogramSlot.
+HEADER = struct.Struct('<8sIIIIIIQQdQII64s')
+ENTRY = struct.Struct('<112sIIQ')
+HISTOGRAM_SLOT = struct.Struct('<112sQQ')
+SEQUENCE_OFFSET = 32
+TYPE_UINT = 1
+TYPE_DOUBLE = 2
+
+def copy_segment(path):
+    """
+    Return a consistent copy of the segment at the given path, or None if the
+    segment is gone or no consistent copy could be taken.
+    """
+    try:
+        with open(path, 'rb') as f:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (IOError, OSError, ValueError):
+        return None
+    try:
+        # The publisher holds an odd sequence number while it rewrites the
+        # segment; retry until a copy starts and ends with the same even one.
+        for attempt in range(1000):
+            before = struct.unpack_from('<Q', mm, SEQUENCE_OFFSET)[0]
+            if before % 2 == 0:
+                data = mm[:]
+                after = struct.unpack_from('<Q', mm, SEQUENCE_OFFSET)[0]
+                if before == after:
+                    return data
+            time.sleep(0.0001)
+        return None
+    finally:
+        mm.close()
+
+def process_alive(pid):
+    try:
+        os.kill(pid, 0)
+    except OSError as error:
+        return error.errno == errno.EPERM
+    return True
+
+def read_segment(path):
+    """
+    Return the stats published in the segment at the given path, or None if
+    the segment is not readable or its server exited without removing it.
+    """
+    data = copy_segment(path)
+    if data is None or len(data) < HEADER.size:
+        return None
+    (magic, version, entry_capacity, histogram_capacity, bucket_count,
+     sub_bucket_bits, max_value_bits, sequence, pid, cycles_per_second,
+     timestamp, entry_count, histogram_count, server_name) = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION or sequence == 0 or not process_alive(pid):
+        return None
+    values = {}
+    offset = HEADER.size
+    for i in range(entry_count):
+        pointer, value_type, reserved, value = ENTRY.unpack_from(data, offset + i * ENTRY.size)
+        if value_type == TYPE_DOUBLE:
+            value = struct.unpack('<d', struct.pack('<Q', value))[0]
+        values[pointer.rstrip('\0')] = value
+    histograms = {}
+    offset += entry_capacity * ENTRY.size
+    slot_size = HISTOGRAM_SLOT.size + bucket_count * 8
+    for i in range(histogram_count):
+        slot_offset = offset + i * slot_size
+        pointer = HISTOGRAM_SLOT.unpack_from(data, slot_offset)[0]
+        counts = struct.unpack_from('<%dQ' % bucket_count, data, slot_offset + HISTOGRAM_SLOT.size)
+        buckets = []
+        for index, count in enumerate(counts):
+            if count != 0:
+                buckets += [index, count]
+        histograms[pointer.rstrip('\0')] = load_histogram({
+            "sub_bucket_bits": sub_bucket_bits, "buckets": buckets})
+    return {"name": server_name.rstrip('\0'),
+            "pid": pid,
+            "cycles_per_second": cycles_per_second,
+            "timestamp": timestamp,
+            "values": values,
+            "histograms": histograms}
+
+def read_segments(server_names):
+    segments = {}
+    for path in glob.glob(SEGMENT_GLOB):
+        segment = read_segment(path)
+        if segment is None:
+            continue
+        if server_names and segment["name"] not in server_names:
+            continue
+        segments[segment["name"]] = segment
+    return segments
+
+def task_count(values):
+    return sum(value for pointer, value in values.items()
+               if pointer.startswith('/task/') and pointer.endswith('/count'))
+
+def rates(start, end):
+    """
+    Return the rates of the server between two reads of its segment, or None
+    if the server did not publish in between.
+    """
+    if start["pid"] != end["pid"] or end["timestamp"] <= start["timestamp"]:
+        return None
+    elapsed = float(end["timestamp"] - start["timestamp"]) / end["cycles_per_second"]
+    def delta(pointer):
+        return end["values"].get(pointer, 0) - start["values"].get(pointer, 0)
+    drops = delta('/client_stats/drops')
+    latency = histogram_diff(end["histograms"].get('/latency', {}),
+                             start["histograms"].get('/latency', {}))
+    transport_cps = end["values"].get('/transport/cycles_per_second', 0)
+    return {"throughput": delta('/client_stats/count') / elapsed / 1000.0,
+            "failures": delta('/client_stats/failures') / elapsed,
+            "drops": drops / elapsed,
+            "tasks": (task_count(end["values"]) - task_count(start["values"])) / elapsed / 1000.0,
+            "p50": percentile(latency, drops, 0.5) / 1000.0,
+            "p99": percentile(latency, drops, 0.99) / 1000.0,
+            "cpu_bench": delta('/active_cycles') / (end["cycles_per_second"] * elapsed),
+            "cpu_poll": delta('/transport/active_cycles') / (transport_cps * elapsed) if transport_cps else 0.0,
+            "tx_mbps": delta('/transport/transport_tx_bytes') * 8 / elapsed / 1e6,
+            "rx_mbps": delta('/transport/transport_rx_bytes') * 8 / elapsed / 1e6}
+
+def print_rates(previous, current):
+    print "%-16s %7s %10s %9s %9s %9s %11s %13s %10s %10s" % (
+        "Server", "PID", "Ops (k/s)", "Drops/s", "Med (us)", "99% (us)", "Tasks (k/s)",
+        "CPU (b/p)", "Tx (Mbps)", "Rx (Mbps)")
+    for name in sorted(current):
+        segment = current[name]
+        server_rates = rates(previous[name], segment) if name in previous else None
+        if server_rates is None:
+            print "%-16s %7d %10s" % (name, segment["pid"], "-")
+            continue
+        print "%-16s %7d %10.3f %9.1f %9.3f %9.3f %11.3f %6.2f/%6.2f %10.1f %10.1f" % (
+            name, segment["pid"], server_rates["throughput"], server_rates["drops"],
+            server_rates["p50"], server_rates["p99"], server_rates["tasks"],
+            server_rates["cpu_bench"], server_rates["cpu_poll"],
+            server_rates["tx_mbps"], server_rates["rx_mbps"])
+
+def main(args):
+    delay = float(args['--delay'])
+    iterations = int(args['--iterations'])
+    previous = read_segments(args['<server_name>'])
+    iteration = 0
+    try:
+        while iterations == 0 or iteration < iterations:
+            time.sleep(delay)
+            current = read_segments(args['<server_name>'])
+            if sys.stdout.isatty():
+                sys.stdout.write('\033[H\033[2J')
+            print time.strftime('%H:%M:%S'), "(%d servers)" % len(current)
+            print_rates(previous, current)
+            sys.stdout.flush()
+            previous = current
+            iteration += 1
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == '__main__':
+    args = docopt(__doc__)
+    main(args)
@@ -0,0 +1,107 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Affinity.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace RooBench {
+namespace Affinity {
+
+/**
+ * Restrict the calling thread to run only on the given CPU.
+ *
+ * @return
+ *      True if the thread was successfully pinned.
+ */
+bool
+pinThread(int cpu)
+{
+    return pinThread(std::vector<int>({cpu}));
+}
+
+/**
+ * Restrict the calling thread to run only on the given set of CPUs.
+ *
+ * @return
+ *      True if the thread's affinity was successfully set.
+ */
+bool
+pinThread(const std::vector<int>& cpus)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) ==
+           0;
+}
+
+/**
+ * Save the affinity of the calling thread.
+ */
+Guard::Guard()
+    : cpuset()
+    , saved(false)
+{
+    saved = pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) ==
+            0;
+}
+
+/**
+ * Restore the affinity saved when the guard was created.
+ */
+Guard::~Guard()
+{
+    if (saved) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    }
+}
+
+/**
+ * Return the NUMA node to which the given CPU belongs, or -1 if unknown.
+ */
+int
+numaNode(int cpu)
+{
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    for (dirent* entry = readdir(dir); entry != nullptr;
+         entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0) {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+}  // namespace Affinity
+}  // namespace RooBench
@@ -0,0 +1,50 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_AFFINITY_H
+#define ROOBENCH_AFFINITY_H
+
+#include <sched.h>
+
+#include <vector>
+
+namespace RooBench {
+namespace Affinity {
+
+bool pinThread(int cpu);
+bool pinThread(const std::vector<int>& cpus);
+int numaNode(int cpu);
+
+/**
+ * Saves the CPU affinity of the calling thread and restores it when
+ * destroyed; must be destroyed by the thread that created it.
+ */
+class Guard {
+  public:
+    Guard();
+    ~Guard();
+
+  private:
+    /// CPUs the thread was allowed to run on when the guard was created.
+    cpu_set_t cpuset;
+
+    /// True if the affinity could be read and should be restored.
+    bool saved;
+};
+
+}  // namespace Affinity
+}  // namespace RooBench
+
+#endif  // ROOBENCH_AFFINITY_H
@@ -38,6 +38,8 @@ struct BenchConfig {
 
     struct Server {
         std::string address;
+        /// Name under which the server's stats are reported.
+        std::string name;
     };
     using ServerList = std::unordered_map<int, Server>;
 
@@ -62,12 +64,109 @@ struct BenchConfig {
     };
     using TaskMap = std::unordered_map<int, Task>;
 
+    /**
+     * Step of the load schedule
+     */
+    struct LoadStep {
+        /// Length of the step in seconds; the last step lasts until the
+        /// benchmark stops.
+        double duration;
+        /// Operations per second offered by all clients during the step.
+        double load;
+    };
+
+    /**
+     * Closed-loop load parameters
+     */
+    struct ClosedLoop {
+        /// Number of ops each client node keeps in flight; 0 selects the
+        /// open-loop load model driven by load.
+        int concurrency;
+        /// Time in microseconds a client waits after an op completes before
+        /// issuing the next op in its place.
+        double thinkTimeUs;
+    };
+
+    /**
+     * Limit on the open-loop ops a client node keeps in flight; ops offered
+     * beyond the limit wait until ops complete, and are dropped once as many
+     * ops wait as may be in flight.
+     */
+    struct Outstanding {
+        /// Fixed limit per client node; 0 derives the limit from the offered
+        /// load and the expected op latency.
+        int limit;
+        /// Op latency in microseconds assumed when deriving the limit.
+        double expectedLatencyUs;
+        /// Factor by which the derived limit exceeds the expected number of
+        /// ops in flight.
+        double headroom;
+    };
+
+    /**
+     * Measurement window parameters
+     */
+    struct Windows {
+        /// True if the benchmark should time its own stats snapshots.
+        bool enabled;
+        /// Seconds after the start before the measurement window opens.
+        double warmup;
+        /// Length of the measurement window in seconds.
+        double measurement;
+        /// Seconds after the measurement window before the benchmark stops.
+        double cooldown;
+    };
+
+    /**
+     * Driver configuration parameters
+     */
+    struct Driver {
+        /// Which Homa::Driver implementation to use ("dpdk", "fake" or "udp").
+        std::string type;
+        /// DPDK port, or UDP port (0 for ephemeral), the driver should bind.
+        int port;
+        /// Value of the DPDK driver's HIGHEST_PACKET_PRIORITY_OVERRIDE.
+        int priorityOverride;
+        /// Network interface whose IPv4 address the UDP driver should use.
+        std::string interface;
+        /// Number of packets per sendmmsg()/recvmmsg() call (UDP only).
+        int batchSize;
+        /// True if the UDP driver should use generic segmentation offload.
+        bool gso;
+        /// Link bandwidth in Mbps reported by the UDP driver.
+        int bandwidth;
+    };
+
+    /**
+     * Thread placement parameters
+     */
+    struct Placement {
+        /// CPUs to which the benchmark threads are pinned round-robin.
+        std::vector<int> cpus;
+        /// CPUs for client role threads; falls back to cpus if empty.
+        std::vector<int> client_cpus;
+        /// CPUs for server role threads; falls back to cpus if empty.
+        std::vector<int> server_cpus;
+    };
+    using PlacementMap = std::unordered_map<std::string, Placement>;
+
     Client client;
     TaskMap tasks;
     ServerList serverList;
     int client_count;
     bool unified;
+    int client_threads;
     double load;
+    std::vector<LoadStep> load_schedule;
+    ClosedLoop closed_loop;
+    Outstanding outstanding;
+    Windows windows;
+    Driver driver;
+    PlacementMap placement;
+    bool stats_json;
+    double sample_period_ms;
+    double live_stats_period_ms;
+    bool payload_hugepages;
 
     explicit BenchConfig(const nlohmann::json& config)
         : serverList()
@@ -76,6 +175,17 @@ struct BenchConfig {
         , client_count()
         , load()
         , unified(false)
+        , client_threads()
+        , load_schedule()
+        , closed_loop()
+        , outstanding()
+        , windows()
+        , driver()
+        , placement()
+        , stats_json(false)
+        , sample_period_ms(0)
+        , live_stats_period_ms(100)
+        , payload_hugepages(false)
     {
         // Load workload
         auto& workload_config = config.at("workload");
@@ -123,14 +233,107 @@ struct BenchConfig {
 
         // Load server list
         for (auto& server : config.at("server_list").at("servers")) {
-            serverList.insert({server.at("id").get<int>(),
-                               {server.at("address").get<std::string>()}});
+            const int server_id = server.at("id").get<int>();
+            serverList.insert(
+                {server_id,
+                 {server.at("address").get<std::string>(),
+                  server.value("name",
+                               "server-" + std::to_string(server_id))}});
         }
 
         // Load other configurations
         client_count = config.at("client_count");
         load = config.at("load");
         unified = config.at("unified");
+        client_threads = config.value("client_threads", 0);
+        stats_json = config.value("stats_json", false);
+        sample_period_ms = config.value("sample_period_ms", 0.0);
+        live_stats_period_ms = config.value("live_stats_period_ms", 100.0);
+        payload_hugepages = config.value("payload_hugepages", false);
+
+        // Load the load schedule, given either as a list of steps or as a
+        // linear ramp split into equal steps; a single step at the fixed
+        // load if not present.
+        if (config.contains("load_schedule")) {
+            auto& schedule_config = config.at("load_schedule");
+            if (schedule_config.contains("ramp")) {
+                auto& ramp_config = schedule_config.at("ramp");
+                double from = ramp_config.at("from").get<double>();
+                double to = ramp_config.at("to").get<double>();
+                double duration = ramp_config.at("duration").get<double>();
+                int steps = ramp_config.at("steps").get<int>();
+                for (int i = 0; i < steps; ++i) {
+                    double fraction = steps > 1 ? double(i) / (steps - 1) : 0;
+                    load_schedule.push_back(
+                        {duration / steps, from + (to - from) * fraction});
+                }
+            } else {
+                for (auto& step_config : schedule_config.at("steps")) {
+                    load_schedule.push_back(
+                        {step_config.at("duration").get<double>(),
+                         step_config.at("load").get<double>()});
+                }
+            }
+        }
+        if (load_schedule.empty()) {
+            load_schedule.push_back({0.0, load});
+        }
+
+        // Load closed-loop configuration; open loop if not present.
+        nlohmann::json closed_loop_config =
+            config.value("closed_loop", nlohmann::json::object());
+        closed_loop.concurrency = closed_loop_config.value("concurrency", 0);
+        closed_loop.thinkTimeUs =
+            closed_loop_config.value("think_time_us", 0.0);
+
+        // Load the outstanding-op limit; either a fixed number or the
+        // parameters from which the limit is derived.  By default, the limit
+        // covers the ops offered during 100 ms.
+        nlohmann::json outstanding_config =
+            config.value("max_outstanding", nlohmann::json::object());
+        if (outstanding_config.is_number()) {
+            outstanding.limit = outstanding_config.get<int>();
+            outstanding_config = nlohmann::json::object();
+        } else {
+            outstanding.limit = 0;
+        }
+        outstanding.expectedLatencyUs =
+            outstanding_config.value("expected_latency_us", 100000.0);
+        outstanding.headroom = outstanding_config.value("headroom", 1.0);
+
+        // Load measurement windows; stats snapshots are left to the user if
+        // not present.
+        windows.enabled = config.contains("windows");
+        nlohmann::json windows_config =
+            config.value("windows", nlohmann::json::object());
+        windows.warmup = windows_config.value("warmup", 0.0);
+        windows.measurement = windows_config.value("measurement", 0.0);
+        windows.cooldown = windows_config.value("cooldown", 0.0);
+
+        // Load driver configuration; defaults to the DPDK driver on port 1.
+        nlohmann::json driver_config =
+            config.value("driver", nlohmann::json::object());
+        driver.type = driver_config.value("type", std::string("dpdk"));
+        driver.port = driver_config.value("port", driver.type == "udp" ? 0 : 1);
+        driver.priorityOverride = driver_config.value("priority_override", 0);
+        driver.interface = driver_config.value("interface", std::string("lo"));
+        driver.batchSize = driver_config.value("batch_size", 32);
+        driver.gso = driver_config.value("gso", true);
+        driver.bandwidth = driver_config.value("bandwidth", 10000);
+
+        // Load thread placement keyed by server name (or "default")
+        if (config.contains("placement")) {
+            for (auto& elem : config.at("placement").items()) {
+                Placement entry;
+                auto& placement_config = elem.value();
+                entry.cpus = placement_config.value("cpus", std::vector<int>());
+                entry.client_cpus =
+                    placement_config.value("client_cpus", std::vector<int>());
+                entry.server_cpus =
+                    placement_config.value("server_cpus", std::vector<int>());
+                placement.insert({elem.key(), entry});
+            }
+        }
     }
 
     void dumps() const
@@ -167,12 +370,59 @@ struct BenchConfig {
         }
         std::cout << "Server List" << std::endl;
         for (auto elem : serverList) {
-            std::cout << elem.first << " : " << elem.second.address
-                      << std::endl;
+            std::cout << elem.first << " : " << elem.second.address << " ("
+                      << elem.second.name << ")" << std::endl;
         }
         std::cout << "client_count: " << client_count << std::endl;
         std::cout << "load: " << load << std::endl;
         std::cout << "unified: " << unified << std::endl;
+        std::cout << "client_threads: " << client_threads << std::endl;
+        std::cout << "stats_json: " << stats_json << std::endl;
+        std::cout << "sample_period_ms: " << sample_period_ms << std::endl;
+        std::cout << "live_stats_period_ms: " << live_stats_period_ms
+                  << std::endl;
+        std::cout << "payload_hugepages: " << payload_hugepages << std::endl;
+        std::cout << "load_schedule:";
+        for (auto& step : load_schedule) {
+            std::cout << " {duration: " << step.duration
+                      << ", load: " << step.load << "}";
+        }
+        std::cout << std::endl;
+        std::cout << "closed_loop: " << closed_loop.concurrency
+                  << " (think_time_us: " << closed_loop.thinkTimeUs << ")"
+                  << std::endl;
+        if (outstanding.limit > 0) {
+            std::cout << "max_outstanding: " << outstanding.limit << std::endl;
+        } else {
+            std::cout << "max_outstanding: {expected_latency_us: "
+                      << outstanding.expectedLatencyUs
+                      << ", headroom: " << outstanding.headroom << "}"
+                      << std::endl;
+        }
+        if (windows.enabled) {
+            std::cout << "windows: {warmup: " << windows.warmup
+                      << ", measurement: " << windows.measurement
+                      << ", cooldown: " << windows.cooldown << "}"
+                      << std::endl;
+        }
+        std::cout << "driver: " << driver.type << " (port: " << driver.port
+                  << ")" << std::endl;
+        std::cout << "Placement" << std::endl;
+        for (auto& elem : placement) {
+            std::cout << elem.first << " : cpus";
+            for (int cpu : elem.second.cpus) {
+                std::cout << " " << cpu;
+            }
+            std::cout << " client_cpus";
+            for (int cpu : elem.second.client_cpus) {
+                std::cout << " " << cpu;
+            }
+            std::cout << " server_cpus";
+            for (int cpu : elem.second.server_cpus) {
+                std::cout << " " << cpu;
+            }
+            std::cout << std::endl;
+        }
     }
 };
 
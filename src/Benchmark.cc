@@ -15,13 +15,53 @@
 
 #include "Benchmark.h"
 
-#include <signal.h>
+#include <PerfUtils/Cycles.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+
+#include "Affinity.h"
+#include "Controller.h"
+#include "LiveStats.h"
+#include "MetricsServer.h"
+#include "StatsWriter.h"
 
 namespace RooBench {
 
+namespace {
+
+/**
+ * Return the placement of the given server; a server without its own
+ * placement entry uses the "default" entry, if any.
+ */
+BenchConfig::Placement
+find_placement(const BenchConfig& config, const std::string& server_name)
+{
+    auto it = config.placement.find(server_name);
+    if (it == config.placement.end()) {
+        it = config.placement.find("default");
+    }
+    if (it == config.placement.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+/**
+ * Return the index-th CPU of the given list, wrapping around, or -1 if the
+ * list is empty.
+ */
+int
+select_cpu(const std::vector<int>& cpus, size_t index)
+{
+    return cpus.empty() ? -1 : cpus.at(index % cpus.size());
+}
+
+}  // namespace
+
 /**
  * Benchmark constructor
  *
@@ -33,6 +73,13 @@ namespace RooBench {
  *      Directory for log and stats output.
  * @param num_threads
  *      The number of threads that should be running run_benchmark().
+ *
+ * If the configuration assigns CPUs to this server, the calling thread is
+ * pinned to those CPUs so that the memory first touched while constructing
+ * the benchmark (stats, pools, driver buffers) is placed on their NUMA node.
+ * The caller should restore its affinity once the benchmark is constructed
+ * (see BenchmarkFactory::createBenchmark()); otherwise the threads it
+ * creates later inherit the benchmark's CPUs.
  */
 Benchmark::Benchmark(nlohmann::json bench_config, std::string server_name,
                      std::string output_dir, size_t num_threads)
@@ -40,8 +87,36 @@ Benchmark::Benchmark(nlohmann::json bench_config, std::string server_name,
     , output_dir(output_dir)
     , config(bench_config)
     , num_threads(num_threads)
+    , client_threads(std::min(num_threads,
+                              static_cast<size_t>(config.client_threads)))
+    , placement(find_placement(config, server_name))
+    , thread_info()
     , benchmark_threads()
-{}
+    , sampler_thread()
+    , live_stats_thread()
+    , background_mutex()
+    , background_cond()
+    , background_running(true)
+    , run_state(RunState::IDLE)
+    , run_start_cycles(0)
+    , window_start_cycles(config.windows.enabled
+                              ? std::numeric_limits<uint64_t>::max()
+                              : 0)
+    , window_stop_cycles(std::numeric_limits<uint64_t>::max())
+    , cooldown_stop_cycles(0)
+    , snapshot_cycles(0)
+    , dump_count(0)
+{
+    std::vector<int> cpus = placement.cpus;
+    cpus.insert(cpus.end(), placement.client_cpus.begin(),
+                placement.client_cpus.end());
+    cpus.insert(cpus.end(), placement.server_cpus.begin(),
+                placement.server_cpus.end());
+    if (!cpus.empty() && !Affinity::pinThread(cpus)) {
+        std::cerr << "Unable to pin " << server_name << " to its CPUs"
+                  << std::endl;
+    }
+}
 
 /**
  * Default Benchmark destructor.
@@ -49,47 +124,386 @@ Benchmark::Benchmark(nlohmann::json bench_config, std::string server_name,
 Benchmark::~Benchmark() = default;
 
 /**
+ * Run the benchmark until it is told to stop.
  *
+ * @param control_path
+ *      Path at which the control socket should be created; empty for none.
+ * @param config_path
+ *      Path of the bench config reread by the reload command.
+ * @param metrics_address
+ *      Address at which the metrics should be served; empty for none.
  */
 void
-Benchmark::run()
+Benchmark::run(const std::string& control_path, const std::string& config_path,
+               const std::string& metrics_address)
+{
+    // The controller blocks the signals it handles before the benchmark
+    // threads inherit the signal mask.
+    Controller controller({this}, control_path, config_path);
+    std::unique_ptr<MetricsServer> metrics;
+    if (!metrics_address.empty()) {
+        metrics.reset(new MetricsServer({this}, metrics_address));
+    }
+    start();
+    controller.run();
+    join();
+}
+
+void
+Benchmark::start()
 {
+    // The first client_threads threads are dedicated to the client role;
+    // nodes that run no client only serve.  CPUs are assigned round-robin
+    // from the role's CPU list if one is configured and from the general
+    // list otherwise.
+    for (size_t i = 0; i < num_threads; ++i) {
+        Role role = Role::UNIFIED;
+        int cpu = select_cpu(placement.cpus, i);
+        if (!is_client_node()) {
+            role = Role::SERVER;
+            if (!placement.server_cpus.empty()) {
+                cpu = select_cpu(placement.server_cpus, i);
+            }
+        } else if (client_threads > 0 && i < client_threads) {
+            role = Role::CLIENT;
+            if (!placement.client_cpus.empty()) {
+                cpu = select_cpu(placement.client_cpus, i);
+            }
+        } else if (client_threads > 0) {
+            role = Role::SERVER;
+            if (!placement.server_cpus.empty()) {
+                cpu = select_cpu(placement.server_cpus, i - client_threads);
+            }
+        }
+        int numa_node = cpu < 0 ? -1 : Affinity::numaNode(cpu);
+        thread_info.push_back({i, role, cpu, numa_node});
+    }
     // Start all benchmark threads
     for (size_t i = 0; i < num_threads; ++i) {
-        benchmark_threads.emplace_back(&Benchmark::run_benchmark, this);
+        benchmark_threads.emplace_back(&Benchmark::benchmark_main, this, i);
+    }
+    if (config.sample_period_ms > 0) {
+        sampler_thread = std::thread(&Benchmark::sampler_main, this);
     }
-    handleSignals();
+    if (config.live_stats_period_ms > 0) {
+        live_stats_thread = std::thread(&Benchmark::live_stats_main, this);
+    }
+}
+
+void
+Benchmark::join()
+{
     // Wait for benchmark threads to complete.
     for (auto thread = benchmark_threads.begin();
          thread != benchmark_threads.end(); ++thread) {
         thread->join();
     }
+    {
+        std::lock_guard<std::mutex> lock(background_mutex);
+        background_running = false;
+    }
+    background_cond.notify_all();
+    if (sampler_thread.joinable()) {
+        sampler_thread.join();
+    }
+    if (live_stats_thread.joinable()) {
+        live_stats_thread.join();
+    }
 }
 
+/**
+ * Append a sample of the stats to the time series every sample period
+ * until sampling stops.
+ *
+ * Each sample holds the time it was taken, the latency histogram of the ops
+ * completed since the previous sample, and the benchmark's cumulative
+ * counters; readers diff consecutive samples to get per-interval rates.
+ */
 void
-Benchmark::handleSignals()
-{
-    sigset_t sigset;
-    sigemptyset(&sigset);
-    sigaddset(&sigset, SIGINT);
-    sigaddset(&sigset, SIGUSR1);
-    sigaddset(&sigset, SIGUSR2);
-    sigprocmask(SIG_BLOCK, &sigset, NULL);
-
-    while (true) {
-        int sig, error;
-        error = sigwait(&sigset, &sig);
-        if (sig == SIGINT) {
-            stop();
-            break;
-        } else if (sig == SIGUSR1) {
-            start_client();
-        } else if (sig == SIGUSR2) {
-            dump_stats();
-        } else {
-            exit(1);
+Benchmark::sampler_main()
+{
+    StatsWriter out(output_dir + "/" + server_name + "_timeseries", false);
+    out.number("/cycles_per_second", PerfUtils::Cycles::perSecond());
+    out.number("/period_ms", config.sample_period_ms);
+    out.flush();
+
+    std::chrono::microseconds const period(
+        static_cast<int64_t>(config.sample_period_ms * 1000));
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now();
+    Histogram previous_latency;
+    size_t index = 0;
+    while (wait_period(&deadline, period)) {
+        std::string const prefix = "/samples/" + std::to_string(index++);
+        out.gauge(prefix + "/timestamp", PerfUtils::Cycles::rdtsc());
+        Histogram latency = client_latency();
+        Histogram interval_latency = latency;
+        interval_latency.subtract(previous_latency);
+        previous_latency = latency;
+        out.histogram(prefix + "/latency", interval_latency);
+        sample_stats(out, prefix);
+        out.flush();
+    }
+}
+
+/**
+ * Publish the stats to the live stats segment every live stats period until
+ * the benchmark stops.
+ *
+ * The segment holds the cumulative client latency histogram and the same
+ * counters as the time series samples.  The benchmark threads are not
+ * involved: their stats are read the same way the dumps read them.
+ */
+void
+Benchmark::live_stats_main()
+{
+    LiveStats live(server_name);
+    if (!live.valid()) {
+        return;
+    }
+    std::chrono::microseconds const period(
+        static_cast<int64_t>(config.live_stats_period_ms * 1000));
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now();
+    do {
+        // Collect the values first so that the publication, during which
+        // readers retry, stays short.
+        Histogram const latency = client_latency();
+        live.begin();
+        live.histogram("/latency", latency);
+        sample_stats(live, "");
+        live.end();
+    } while (wait_period(&deadline, period));
+}
+
+/**
+ * Wait until one period after the given deadline, skipping the periods
+ * that are already over rather than running them back to back.
+ *
+ * @param deadline
+ *      End of the previous period; set to the end of the period waited for.
+ * @param period
+ *      Length of the period.
+ * @return
+ *      True once the period is over; false as soon as the background threads
+ *      should stop.
+ */
+bool
+Benchmark::wait_period(std::chrono::steady_clock::time_point* deadline,
+                       std::chrono::microseconds period)
+{
+    *deadline = std::max(*deadline + period, std::chrono::steady_clock::now());
+    std::unique_lock<std::mutex> lock(background_mutex);
+    return !background_cond.wait_until(
+        lock, *deadline, [this] { return !background_running; });
+}
+
+/**
+ * Pin the calling thread according to its placement and run the benchmark.
+ *
+ * Per-thread state allocated by run_benchmark() is first touched after
+ * pinning and thus lands on the thread's local NUMA node.
+ */
+void
+Benchmark::benchmark_main(size_t id)
+{
+    const ThreadInfo& info = thread_info.at(id);
+    if (info.cpu >= 0 && !Affinity::pinThread(info.cpu)) {
+        std::cerr << "Unable to pin thread " << id << " to CPU " << info.cpu
+                  << std::endl;
+    }
+    run_benchmark(info);
+}
+
+/**
+ * Return the placement of all benchmark threads as a JSON list.
+ */
+nlohmann::json
+Benchmark::thread_placement() const
+{
+    std::vector<nlohmann::json> placement;
+    for (const ThreadInfo& info : thread_info) {
+        nlohmann::json info_json;
+        info_json["thread"] = info.id;
+        switch (info.role) {
+            case Role::UNIFIED:
+                info_json["role"] = "unified";
+                break;
+            case Role::CLIENT:
+                info_json["role"] = "client";
+                break;
+            case Role::SERVER:
+                info_json["role"] = "server";
+                break;
         }
+        info_json["cpu"] = info.cpu;
+        info_json["numa_node"] = info.numa_node;
+        placement.push_back(info_json);
+    }
+    return nlohmann::json(placement);
+}
+
+/**
+ * Return the number of benchmark threads with the given role.
+ */
+size_t
+Benchmark::thread_count(Role role) const
+{
+    if (!is_client_node()) {
+        return role == Role::SERVER ? num_threads : 0;
+    } else if (client_threads == 0) {
+        return role == Role::UNIFIED ? num_threads : 0;
+    } else if (role == Role::CLIENT) {
+        return client_threads;
+    } else if (role == Role::SERVER) {
+        return num_threads - client_threads;
+    }
+    return 0;
+}
+
+/**
+ * Return the time to which the stats being dumped should be attributed: the
+ * window boundary for self-timed snapshots and the current time otherwise.
+ */
+uint64_t
+Benchmark::stats_timestamp() const
+{
+    return snapshot_cycles != 0 ? snapshot_cycles
+                                : PerfUtils::Cycles::rdtsc();
+}
+
+/**
+ * Start the benchmark client and, if configured, the measurement windows.
+ *
+ * The window boundaries are fixed in TSC cycles relative to the start time
+ * so that the window lengths do not depend on when the snapshots are
+ * actually taken.
+ *
+ * @param start_cycles
+ *      Time at which the run starts; the client issues no operations before
+ *      this time.
+ */
+void
+Benchmark::begin_run(uint64_t start_cycles)
+{
+    start_client(start_cycles);
+    if (run_state != RunState::IDLE) {
+        return;
+    }
+    run_start_cycles = start_cycles;
+    if (!config.windows.enabled) {
+        run_state = RunState::RUNNING;
+        return;
+    }
+    uint64_t const start =
+        start_cycles + PerfUtils::Cycles::fromSeconds(config.windows.warmup);
+    uint64_t const stop =
+        start + PerfUtils::Cycles::fromSeconds(config.windows.measurement);
+    window_stop_cycles = stop;
+    window_start_cycles = start;
+    cooldown_stop_cycles =
+        stop + PerfUtils::Cycles::fromSeconds(config.windows.cooldown);
+    run_state = RunState::WARMUP;
+}
+
+/**
+ * Take the stats snapshots at the opening and closing of the measurement
+ * window and stop the benchmark at the end of the cooldown.
+ *
+ * Only ops that start in the window are recorded, and those still in flight
+ * when it closes are the slowest ones.  The closing snapshot is therefore
+ * taken once they have completed, or at the end of the cooldown at the
+ * latest, and is attributed to the time the window closed.
+ *
+ * @return
+ *      Time of the next window boundary; 0 if there is none.
+ */
+uint64_t
+Benchmark::advance_windows()
+{
+    uint64_t const now = PerfUtils::Cycles::rdtsc();
+    if (run_state == RunState::WARMUP && now >= window_start_cycles) {
+        snapshot_cycles = window_start_cycles;
+        snapshot();
+        run_state = RunState::MEASUREMENT;
+    }
+    if (run_state == RunState::MEASUREMENT &&
+        now >= window_stop_cycles) {
+        run_state = RunState::DRAINING;
+    }
+    if (run_state == RunState::DRAINING &&
+        (in_window_outstanding() == 0 || now >= cooldown_stop_cycles)) {
+        snapshot_cycles = window_stop_cycles;
+        snapshot();
+        run_state = RunState::COOLDOWN;
+    }
+    if (run_state == RunState::COOLDOWN && now >= cooldown_stop_cycles) {
+        stop();
+        run_state = RunState::DONE;
+    }
+    snapshot_cycles = 0;
+
+    switch (run_state) {
+        case RunState::WARMUP:
+            return window_start_cycles;
+        case RunState::MEASUREMENT:
+            return window_stop_cycles;
+        case RunState::DRAINING:
+            // Check again shortly for the window's remaining ops.
+            return std::min(now + PerfUtils::Cycles::fromSeconds(0.01),
+                            cooldown_stop_cycles);
+        case RunState::COOLDOWN:
+            return cooldown_stop_cycles;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Dump the stats labeled with the number of the dump.
+ */
+void
+Benchmark::snapshot()
+{
+    dump_stats(std::to_string(dump_count++));
+}
+
+/**
+ * Return the progress of the benchmark for status requests.
+ */
+nlohmann::json
+Benchmark::get_status()
+{
+    nlohmann::json status = this->status();
+    switch (run_state) {
+        case RunState::IDLE:
+            status["state"] = "idle";
+            break;
+        case RunState::RUNNING:
+            status["state"] = "running";
+            break;
+        case RunState::WARMUP:
+            status["state"] = "warmup";
+            break;
+        case RunState::MEASUREMENT:
+            status["state"] = "measurement";
+            break;
+        case RunState::DRAINING:
+            status["state"] = "draining";
+            break;
+        case RunState::COOLDOWN:
+            status["state"] = "cooldown";
+            break;
+        case RunState::DONE:
+            status["state"] = "done";
+            break;
+    }
+    if (run_state != RunState::IDLE && run_state != RunState::DONE &&
+        PerfUtils::Cycles::rdtsc() < run_start_cycles) {
+        status["state"] = "scheduled";
     }
+    status["dump_count"] = dump_count;
+    return status;
 }
 
 }  // namespace RooBench
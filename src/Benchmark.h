@@ -17,15 +17,26 @@
 #define ROOBENCH_BENCHMARK_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "BenchConfig.h"
+#include "Histogram.h"
+#include "StatsSink.h"
 
 namespace RooBench {
 
+// Forward Declarations
+class Cluster;
+class Controller;
+class MetricsServer;
+
 /**
  * Base class for all Roobench benchmarks
  *
@@ -36,25 +47,64 @@ class Benchmark {
     Benchmark(nlohmann::json bench_config, std::string server_name,
               std::string output_dir, size_t num_threads);
     virtual ~Benchmark();
-    void run();
+    void run(const std::string& control_path, const std::string& config_path,
+             const std::string& metrics_address);
 
   protected:
+    /**
+     * Work performed by a thread running run_benchmark().
+     */
+    enum class Role {
+        UNIFIED,  //< Alternates between client and server work.
+        CLIENT,   //< Only generates and tracks client operations.
+        SERVER,   //< Only polls the socket and serves incoming requests.
+    };
+
+    /**
+     * Describes the role and placement of a thread running run_benchmark().
+     */
+    struct ThreadInfo {
+        /// Index of the thread among this benchmark's threads.
+        size_t id;
+
+        /// Work this thread should perform.
+        Role role;
+
+        /// CPU to which the thread is pinned; -1 if the thread is not pinned.
+        int cpu;
+
+        /// NUMA node of the thread's CPU; -1 if unknown.
+        int numa_node;
+    };
+
     /**
      * Runs the actual benchmark logic.  Multiple instances may exist.
+     *
+     * @param info
+     *      Role and placement of the calling thread.
      */
-    virtual void run_benchmark() = 0;
+    virtual void run_benchmark(const ThreadInfo& info) = 0;
 
     /**
      * Called when the benchmark should dump the current statistics.
      *
      * Implemented by Benchmark subclasses.  Must be thread-safe.
+     *
+     * @param label
+     *      Suffix that distinguishes the output files of this dump from
+     *      those of other dumps.
      */
-    virtual void dump_stats() = 0;
+    virtual void dump_stats(const std::string& label) = 0;
 
     /**
-     * Signal that the benchmark client should start running.
+     * Signal that the benchmark client should start running.  Benchmarks
+     * that do not run a client on this node should ignore the signal.
+     *
+     * @param start_cycles
+     *      Time at which the client should issue its first operations; may
+     *      lie in the future so that several clients start together.
      */
-    virtual void start_client() = 0;
+    virtual void start_client(uint64_t start_cycles) = 0;
 
     /**
      * Signal to the subclass that all instacnes of run_benchmark() should
@@ -62,6 +112,57 @@ class Benchmark {
      */
     virtual void stop() = 0;
 
+    /**
+     * Change the load offered by the benchmark client while it runs.
+     *
+     * @param load
+     *      Operations per second that all clients should offer together.
+     * @return
+     *      False if the benchmark cannot change its load.
+     */
+    virtual bool set_load(double load) = 0;
+
+    /**
+     * Returns benchmark specific progress information for status requests.
+     */
+    virtual nlohmann::json status() = 0;
+
+    /**
+     * Returns the latency histogram of the client ops completed so far.
+     * Must be thread-safe.
+     */
+    virtual Histogram client_latency() = 0;
+
+    /**
+     * Returns the number of client ops dropped so far, which the latency
+     * histogram does not count.  Must be thread-safe.
+     */
+    virtual uint64_t client_drops() = 0;
+
+    /**
+     * Add the benchmark's counters to a sample of the stats time series or
+     * of the live stats.  Must be thread-safe.
+     *
+     * @param out
+     *      Destination of the sample.
+     * @param prefix
+     *      JSON pointer under which the values of the sample belong.
+     */
+    virtual void sample_stats(StatsSink& out, const std::string& prefix) = 0;
+
+    /**
+     * Returns the number of client ops that started in the measurement
+     * window and have not completed yet.  Must be thread-safe.
+     */
+    virtual uint64_t in_window_outstanding() = 0;
+
+    /**
+     * Returns true if this node runs a benchmark client; all threads of
+     * other nodes are servers.  Used by thread_count(), so subclasses must
+     * be able to answer before they size their per-thread state.
+     */
+    virtual bool is_client_node() const = 0;
+
     /// The name assigned to the server running this benchmark instance.  All
     /// output files should be prefixed with this name.
     const std::string server_name;
@@ -72,15 +173,129 @@ class Benchmark {
     /// Benchmark configuration parameters
     const BenchConfig config;
 
+    /// Returns the placement of all benchmark threads for the stats dump.
+    nlohmann::json thread_placement() const;
+
+    /// Returns the number of benchmark threads with the given role.
+    size_t thread_count(Role role) const;
+
+    /**
+     * Returns true if an op started at the given time falls into the
+     * measurement window.  Client stats of other ops should be discarded.
+     */
+    bool in_window(uint64_t cycles) const
+    {
+        return cycles >= window_start_cycles.load(std::memory_order_relaxed) &&
+               cycles < window_stop_cycles.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the time to which the stats being dumped should be attributed.
+    uint64_t stats_timestamp() const;
+
   private:
-    /// Runs the logic of handling async signals
-    void handleSignals();
+    friend class Cluster;
+    friend class Controller;
+    friend class MetricsServer;
+
+    /**
+     * Progress of the benchmark run and its self-timed measurement windows.
+     */
+    enum class RunState {
+        IDLE,         //< Waiting for the benchmark run to start.
+        RUNNING,      //< Run started without self-timed windows.
+        WARMUP,       //< Run started; the measurement window is not open yet.
+        MEASUREMENT,  //< Measurement window is open.
+        DRAINING,     //< Measurement window closed; waiting for its ops.
+        COOLDOWN,     //< Measurement window dumped; waiting to stop.
+        DONE,         //< Benchmark has stopped on its own.
+    };
+
+    /// Spawns the threads running run_benchmark()
+    void start();
+
+    /// Waits for all threads running run_benchmark() to return
+    void join();
+
+    /// Entry point of each benchmark thread.
+    void benchmark_main(size_t id);
+
+    /// Entry point of the thread sampling the stats time series.
+    void sampler_main();
+
+    /// Entry point of the thread publishing the live stats.
+    void live_stats_main();
+
+    /// Waits for the end of the period starting at the given deadline;
+    /// returns false if the background threads should stop instead.
+    bool wait_period(std::chrono::steady_clock::time_point* deadline,
+                     std::chrono::microseconds period);
+
+    /// Starts the client and the measurement windows at the given time.
+    void begin_run(uint64_t start_cycles);
+
+    /// Performs the window transitions that are due; returns the time of the
+    /// next transition or 0 if none is pending.
+    uint64_t advance_windows();
+
+    /// Dumps the stats labeled with the number of the dump.
+    void snapshot();
+
+    /// Returns the progress of the benchmark for status requests.
+    nlohmann::json get_status();
 
     /// The number of instances of run_benchmark() that should be running.
     const size_t num_threads;
 
+    /// Number of threads dedicated to the client role; 0 means all threads
+    /// run in the unified role.
+    const size_t client_threads;
+
+    /// CPUs assigned to this benchmark instance.
+    const BenchConfig::Placement placement;
+
+    /// Placement of each thread running run_benchmark().
+    std::vector<ThreadInfo> thread_info;
+
     /// Set of all threads running run_benchmark()
     std::vector<std::thread> benchmark_threads;
+
+    /// Thread sampling the stats time series; not started if sampling is
+    /// disabled.
+    std::thread sampler_thread;
+
+    /// Thread publishing the live stats; not started if publishing is
+    /// disabled.
+    std::thread live_stats_thread;
+
+    /// Protects background_running.
+    std::mutex background_mutex;
+
+    /// Wakes the background threads up early when they should stop.
+    std::condition_variable background_cond;
+
+    /// True while the sampler and live stats threads should keep running.
+    bool background_running;
+
+    /// Progress of the run and its measurement windows.
+    RunState run_state;
+
+    /// Time at which the run starts or started.
+    uint64_t run_start_cycles;
+
+    /// Time at which the measurement window opens.
+    std::atomic<uint64_t> window_start_cycles;
+
+    /// Time at which the measurement window closes.
+    std::atomic<uint64_t> window_stop_cycles;
+
+    /// Time at which the cooldown ends and the benchmark stops.
+    uint64_t cooldown_stop_cycles;
+
+    /// Window boundary of the snapshot being taken; 0 outside of a snapshot.
+    uint64_t snapshot_cycles;
+
+    /// Number of numbered stats dumps taken so far.
+    int dump_count;
 };
 
 }  // namespace RooBench
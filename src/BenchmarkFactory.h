@@ -18,10 +18,15 @@
 
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <vector>
 
+#include "Affinity.h"
 #include "Benchmark.h"
+#include "Cluster.h"
 #include "DpcBenchmark.h"
+#include "DriverFactory.h"
 #include "FakeBenchmark.h"
 #include "RpcBenchmark.h"
 
@@ -29,29 +34,36 @@ namespace RooBench {
 namespace BenchmarkFactory {
 
 /**
- * Create and return a new benchmark instances based on the given configuration.
+ * Create and return a new benchmark instance from a parsed configuration.
  *
- * @param bench_config
- *      Path to benchmark configuration file.
+ * @param config
+ *      The benchmark configuration.
+ * @param driver
+ *      Driver the benchmark should use to communicate.  If empty, the
+ *      benchmark creates its own driver based on the configuration.
  */
 Benchmark*
-createBenchmark(std::string bench_config, std::string server_name,
-                std::string output_dir_path, size_t num_threads)
+createBenchmark(nlohmann::json config, std::string server_name,
+                std::string output_dir_path, size_t num_threads,
+                std::unique_ptr<Homa::Driver> driver)
 {
-    std::ifstream i(bench_config);
-    nlohmann::json config;
-    i >> config;
     std::string bench_type = config.at("workload").at("bench_type");
 
+    // The benchmark pins this thread to its CPUs while it is constructed.
+    // Restore the thread's affinity afterwards so that the threads started
+    // later (controller, sampler, live stats, metrics) and the other nodes
+    // of a cluster are not confined to this node's CPUs.
+    Affinity::Guard affinity;
+
     if (bench_type == "Fake") {
         return new RooBench::FakeBenchmark(config, server_name, output_dir_path,
                                            num_threads);
     } else if (bench_type == "DPC") {
         return new RooBench::DpcBenchmark(config, server_name, output_dir_path,
-                                          num_threads);
+                                          num_threads, driver.release());
     } else if (bench_type == "RPC") {
         return new RooBench::RpcBenchmark(config, server_name, output_dir_path,
-                                          num_threads);
+                                          num_threads, driver.release());
     } else {
         std::cerr << "Unknown Benchmark type '" << bench_type << "'"
                   << std::endl;
@@ -59,6 +71,87 @@ createBenchmark(std::string bench_config, std::string server_name,
     }
 }
 
+/**
+ * Create and return a new benchmark instances based on the given configuration.
+ *
+ * @param bench_config
+ *      Path to benchmark configuration file.
+ */
+Benchmark*
+createBenchmark(std::string bench_config, std::string server_name,
+                std::string output_dir_path, size_t num_threads)
+{
+    std::ifstream i(bench_config);
+    nlohmann::json config;
+    i >> config;
+    return createBenchmark(config, server_name, output_dir_path, num_threads,
+                           nullptr);
+}
+
+/**
+ * Create and return a Cluster that runs every node of the given benchmark
+ * configuration inside this process.
+ *
+ * Each node communicates through its own Homa FakeDriver, or through its own
+ * UdpDriver on an ephemeral port if the configuration selects the UDP driver;
+ * the addresses in the configuration's server list are replaced with the
+ * nodes' actual addresses.
+ * Nodes are named the same way roobench_run.py names hosts: the first
+ * client_count nodes are client-<n> and the rest are server-<n>.
+ *
+ * @param bench_config
+ *      Path to benchmark configuration file.
+ */
+Cluster*
+createCluster(std::string bench_config, std::string output_dir_path,
+              size_t num_threads)
+{
+    std::ifstream i(bench_config);
+    nlohmann::json config;
+    i >> config;
+
+    const int client_count = config.at("client_count");
+    const bool unified = config.at("unified");
+    nlohmann::json& servers = config.at("server_list").at("servers");
+    BenchConfig::Driver driver_config = BenchConfig(config).driver;
+    if (driver_config.type == "udp") {
+        driver_config.port = 0;
+    } else {
+        driver_config.type = "fake";
+    }
+    config["driver"]["type"] = driver_config.type;
+
+    // In unified mode the clients are part of the server list; otherwise,
+    // they are additional client-only nodes.
+    const size_t node_count = servers.size() + (unified ? 0 : client_count);
+    std::vector<std::unique_ptr<Homa::Driver>> drivers;
+    for (size_t i = 0; i < node_count; ++i) {
+        drivers.emplace_back(DriverFactory::createDriver(driver_config));
+    }
+    for (size_t i = 0; i < servers.size(); ++i) {
+        Homa::Driver* driver =
+            drivers.at(node_count - servers.size() + i).get();
+        servers.at(i)["address"] =
+            driver->addressToString(driver->getLocalAddress());
+    }
+
+    std::vector<Cluster::Node> nodes;
+    for (size_t i = 0; i < node_count; ++i) {
+        bool client = i < static_cast<size_t>(client_count);
+        std::string server_name =
+            client ? "client-" + std::to_string(i + 1)
+                   : "server-" + std::to_string(i + 1 - client_count);
+        Benchmark* benchmark =
+            createBenchmark(config, server_name, output_dir_path, num_threads,
+                            std::move(drivers.at(i)));
+        if (benchmark == nullptr) {
+            return nullptr;
+        }
+        nodes.push_back({std::unique_ptr<Benchmark>(benchmark)});
+    }
+    return new Cluster(std::move(nodes));
+}
+
 }  // namespace BenchmarkFactory
 }  // namespace RooBench
 
@@ -0,0 +1,95 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_CLIENTSHARD_H
+#define ROOBENCH_CLIENTSHARD_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Counter.h"
+#include "Histogram.h"
+
+namespace RooBench {
+
+/**
+ * Client counters written by a single generator.
+ */
+struct alignas(CACHE_LINE_SIZE) ClientCounters {
+    Counter count;
+    Counter failures;
+    Counter drops;
+    Counter offered;
+    Counter delayed;
+    Counter lag_cycles;
+};
+
+/**
+ * Counters of the ops of a load step written by a single generator.
+ */
+struct alignas(CACHE_LINE_SIZE) StepCounters {
+    Counter count;
+    Counter failures;
+    Counter drops;
+    Counter offered;
+};
+
+/**
+ * Counters of the requests sent to a peer by a single generator.  Only the
+ * RPC benchmark sees the requests to each peer complete or fail.
+ */
+struct alignas(CACHE_LINE_SIZE) PeerCounters {
+    Counter sent;
+    Counter completed;
+    Counter failures;
+};
+
+/**
+ * Client stats written by a single generator and summed when read.
+ */
+struct ClientShard {
+    ClientShard(size_t step_count, size_t phase_count, size_t peer_count)
+        : counters()
+        , step_counters(step_count)
+        , peer_counters(peer_count)
+        , steps(step_count)
+        , phases(phase_count)
+        , peers(peer_count)
+    {}
+
+    /// Counters of all ops of the generator.
+    ClientCounters counters;
+
+    /// Counters of the ops of each load step.
+    std::vector<StepCounters> step_counters;
+
+    /// Counters of the requests sent to each peer.
+    std::vector<PeerCounters> peer_counters;
+
+    /// Latency in nanoseconds of the ops of each load step.
+    std::vector<Histogram> steps;
+
+    /// Time in nanoseconds the ops spent in each phase of the workload.
+    std::vector<Histogram> phases;
+
+    /// Latency in nanoseconds of the requests sent to each peer.  A RooPC
+    /// completes as a whole, so in the DPC benchmark the peers that served a
+    /// phase share the phase's latency.
+    std::vector<Histogram> peers;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_CLIENTSHARD_H
@@ -0,0 +1,73 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Cluster.h"
+
+#include "Controller.h"
+#include "MetricsServer.h"
+
+namespace RooBench {
+
+/**
+ * Cluster constructor
+ *
+ * @param nodes
+ *      The set of virtual nodes that should be run as part of this cluster.
+ */
+Cluster::Cluster(std::vector<Node> nodes)
+    : nodes(std::move(nodes))
+{}
+
+/**
+ * Default Cluster destructor.
+ */
+Cluster::~Cluster() = default;
+
+/**
+ * Run all nodes of the cluster until they are told to stop.
+ *
+ * @param control_path
+ *      Path at which the control socket should be created; empty for none.
+ * @param config_path
+ *      Path of the bench config reread by the reload command.
+ * @param metrics_address
+ *      Address at which the metrics of all nodes should be served; empty for
+ *      none.
+ */
+void
+Cluster::run(const std::string& control_path, const std::string& config_path,
+             const std::string& metrics_address)
+{
+    std::vector<Benchmark*> benchmarks;
+    for (Node& node : nodes) {
+        benchmarks.push_back(node.benchmark.get());
+    }
+    // The controller blocks the signals it handles before the benchmark
+    // threads inherit the signal mask.
+    Controller controller(benchmarks, control_path, config_path);
+    std::unique_ptr<MetricsServer> metrics;
+    if (!metrics_address.empty()) {
+        metrics.reset(new MetricsServer(benchmarks, metrics_address));
+    }
+    for (Node& node : nodes) {
+        node.benchmark->start();
+    }
+    controller.run();
+    for (Node& node : nodes) {
+        node.benchmark->join();
+    }
+}
+
+}  // namespace RooBench
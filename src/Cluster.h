@@ -0,0 +1,57 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_CLUSTER_H
+#define ROOBENCH_CLUSTER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+
+namespace RooBench {
+
+/**
+ * Runs several benchmark nodes inside a single process.
+ *
+ * The nodes share a single Controller: signals and control requests apply to
+ * every node, and self-timed measurement windows of all nodes open and close
+ * together.  Note that transport statistics (SimpleRpc/Roo Perf) and time
+ * traces are process wide and thus cover all nodes of the cluster.
+ */
+class Cluster {
+  public:
+    /**
+     * A virtual node of the cluster.
+     */
+    struct Node {
+        /// Benchmark instance playing the role of this node.
+        std::unique_ptr<Benchmark> benchmark;
+    };
+
+    explicit Cluster(std::vector<Node> nodes);
+    ~Cluster();
+    void run(const std::string& control_path, const std::string& config_path,
+             const std::string& metrics_address);
+
+  private:
+    /// All nodes running in this cluster.
+    std::vector<Node> nodes;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_CLUSTER_H
@@ -0,0 +1,515 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Controller.h"
+
+#include <PerfUtils/Cycles.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+
+#include "BenchConfig.h"
+
+namespace RooBench {
+
+namespace {
+
+/**
+ * Return true if the given snapshot label can safely be part of a file name.
+ * Purely numeric labels are reserved for the numbered dumps, which a named
+ * snapshot must not overwrite.
+ */
+bool
+valid_label(const std::string& label)
+{
+    if (label.empty()) {
+        return false;
+    }
+    bool numeric = true;
+    for (char c : label) {
+        if (!isalnum(c) && c != '-' && c != '_' && c != '.') {
+            return false;
+        }
+        if (!isdigit(c)) {
+            numeric = false;
+        }
+    }
+    return !numeric && label != "." && label != "..";
+}
+
+/**
+ * Return the JSON response reporting a failed request.
+ */
+nlohmann::json
+error_response(const std::string& error)
+{
+    nlohmann::json response;
+    response["ok"] = false;
+    response["error"] = error;
+    return response;
+}
+
+/**
+ * Convert a wall-clock time into the corresponding TSC time.
+ *
+ * The wall clock is read between two TSC reads; the pair of reads with the
+ * smallest gap bounds the conversion error best.
+ *
+ * @param wall_time
+ *      Seconds since the epoch according to CLOCK_REALTIME.
+ * @param[out] cycles
+ *      The TSC time corresponding to wall_time.
+ * @return
+ *      False if wall_time has already passed.
+ */
+bool
+wall_clock_to_cycles(double wall_time, uint64_t* cycles)
+{
+    uint64_t best_gap = std::numeric_limits<uint64_t>::max();
+    uint64_t base_cycles = 0;
+    double base_time = 0;
+    for (int i = 0; i < 5; ++i) {
+        timespec now;
+        uint64_t const before = PerfUtils::Cycles::rdtsc();
+        clock_gettime(CLOCK_REALTIME, &now);
+        uint64_t const after = PerfUtils::Cycles::rdtsc();
+        if (after - before < best_gap) {
+            best_gap = after - before;
+            base_cycles = before + (after - before) / 2;
+            base_time = now.tv_sec + now.tv_nsec * 1e-9;
+        }
+    }
+    if (wall_time <= base_time) {
+        return false;
+    }
+    *cycles =
+        base_cycles + PerfUtils::Cycles::fromSeconds(wall_time - base_time);
+    return true;
+}
+
+}  // namespace
+
+/**
+ * Controller constructor
+ *
+ * Blocks the controller's signals for the calling thread; construct the
+ * controller before starting any benchmark threads so that they inherit the
+ * blocked signals.
+ *
+ * @param nodes
+ *      The benchmark nodes the controller should drive.
+ * @param control_path
+ *      Path at which the control socket should be created; empty if the
+ *      controller should only respond to signals.
+ * @param config_path
+ *      Path of the bench config reread by the reload command.
+ */
+Controller::Controller(std::vector<Benchmark*> nodes,
+                       const std::string& control_path,
+                       const std::string& config_path)
+    : nodes(std::move(nodes))
+    , control_path()
+    , config_path(config_path)
+    , sigset()
+    , signal_fd(-1)
+    , listen_fd(-1)
+    , connections()
+    , latency_snapshots(this->nodes.size())
+    , running(true)
+{
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGINT);
+    sigaddset(&sigset, SIGUSR1);
+    sigaddset(&sigset, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+    signal_fd = signalfd(-1, &sigset, SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        throw std::system_error(errno, std::system_category(), "signalfd");
+    }
+
+    if (control_path.empty()) {
+        return;
+    }
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (control_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Control socket path too long: " << control_path
+                  << std::endl;
+        return;
+    }
+    std::strncpy(addr.sun_path, control_path.c_str(), sizeof(addr.sun_path));
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(control_path.c_str());
+    if (listen_fd < 0 ||
+        bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) <
+            0 ||
+        listen(listen_fd, 8) < 0) {
+        std::cerr << "Unable to open control socket " << control_path << ": "
+                  << std::strerror(errno) << std::endl;
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+        return;
+    }
+    this->control_path = control_path;
+}
+
+/**
+ * Controller destructor; removes the control socket.
+ */
+Controller::~Controller()
+{
+    for (Connection& connection : connections) {
+        close(connection.fd);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(control_path.c_str());
+    }
+    close(signal_fd);
+}
+
+/**
+ * Handle signals, measurement windows and control requests until the
+ * benchmark is told to stop.
+ */
+void
+Controller::run()
+{
+    while (running) {
+        uint64_t const deadline = advanceWindows();
+        if (!running) {
+            break;
+        }
+
+        // Sleep until the next window boundary at most, and spin through the
+        // last millisecond since poll() may oversleep by a scheduler tick.
+        int timeout_ms = -1;
+        if (deadline != 0) {
+            uint64_t const now = PerfUtils::Cycles::rdtsc();
+            uint64_t const spin_cycles = PerfUtils::Cycles::fromSeconds(0.001);
+            if (now + spin_cycles >= deadline) {
+                while (PerfUtils::Cycles::rdtsc() < deadline) {
+                    // spin
+                }
+                continue;
+            }
+            uint64_t const sleep_ns =
+                PerfUtils::Cycles::toNanoseconds(deadline - now - spin_cycles);
+            timeout_ms = std::min<uint64_t>(sleep_ns / 1000000, INT_MAX);
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back({signal_fd, POLLIN, 0});
+        if (listen_fd >= 0) {
+            fds.push_back({listen_fd, POLLIN, 0});
+        }
+        for (Connection& connection : connections) {
+            fds.push_back({connection.fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), timeout_ms) <= 0) {
+            continue;
+        }
+
+        if (fds.at(0).revents & POLLIN) {
+            signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                handleSignal(info.ssi_signo);
+            }
+        }
+        size_t next = 1;
+        if (listen_fd >= 0) {
+            if (fds.at(next++).revents & POLLIN) {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd >= 0) {
+                    connections.push_back({fd, std::string()});
+                }
+            }
+        }
+        // Connections accepted above have no poll result yet.
+        for (auto it = connections.begin(); next < fds.size() && running;
+             ++next) {
+            if (fds.at(next).revents != 0) {
+                handleConnection(&*it);
+            }
+            if (it->fd < 0) {
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+/**
+ * Perform the action associated with the given signal.
+ */
+void
+Controller::handleSignal(int sig)
+{
+    if (sig == SIGINT) {
+        stop();
+    } else if (sig == SIGUSR1) {
+        start(PerfUtils::Cycles::rdtsc());
+    } else if (sig == SIGUSR2) {
+        for (Benchmark* node : nodes) {
+            node->snapshot();
+        }
+    }
+}
+
+/**
+ * Read the pending data of a control connection and answer all complete
+ * requests.  The connection's fd is set to -1 once it is closed.
+ */
+void
+Controller::handleConnection(Connection* connection)
+{
+    char buf[4096];
+    ssize_t length = read(connection->fd, buf, sizeof(buf));
+    if (length <= 0) {
+        close(connection->fd);
+        connection->fd = -1;
+        return;
+    }
+    connection->buffer.append(buf, length);
+
+    size_t pos;
+    while ((pos = connection->buffer.find('\n')) != std::string::npos) {
+        std::string line = connection->buffer.substr(0, pos);
+        connection->buffer.erase(0, pos + 1);
+        std::string response = handleRequest(line).dump() + "\n";
+        if (send(connection->fd, response.data(), response.size(),
+                 MSG_NOSIGNAL) != static_cast<ssize_t>(response.size())) {
+            close(connection->fd);
+            connection->fd = -1;
+            return;
+        }
+    }
+}
+
+/**
+ * Execute a single control request.
+ *
+ * @param line
+ *      The request; a JSON object with a "command" field.
+ * @return
+ *      The JSON response to the request.
+ */
+nlohmann::json
+Controller::handleRequest(const std::string& line)
+{
+    nlohmann::json request;
+    try {
+        request = nlohmann::json::parse(line);
+    } catch (const nlohmann::json::exception& e) {
+        return error_response(e.what());
+    }
+    if (!request.is_object() || !request.contains("command") ||
+        !request.at("command").is_string()) {
+        return error_response("missing command");
+    }
+
+    nlohmann::json response;
+    response["ok"] = true;
+    const std::string command = request.at("command");
+    try {
+        if (command == "start") {
+            uint64_t start_cycles = PerfUtils::Cycles::rdtsc();
+            if (request.contains("at") &&
+                !wall_clock_to_cycles(request.at("at").get<double>(),
+                                      &start_cycles)) {
+                return error_response("start time has passed");
+            }
+            start(start_cycles);
+        } else if (command == "stop") {
+            stop();
+        } else if (command == "snapshot") {
+            if (request.contains("name")) {
+                const std::string label = request.at("name");
+                if (!valid_label(label)) {
+                    return error_response("invalid snapshot name");
+                }
+                snapshot(label);
+            } else {
+                for (Benchmark* node : nodes) {
+                    node->snapshot();
+                }
+            }
+        } else if (command == "set-load") {
+            if (!setLoad(request.at("load").get<double>())) {
+                return error_response("load cannot be changed");
+            }
+        } else if (command == "status") {
+            response["nodes"] = status();
+        } else if (command == "latency") {
+            response["nodes"] = latency(
+                request.value("percentiles", std::vector<double>()));
+        } else if (command == "reload") {
+            // Only the load can change while the benchmark is running.
+            std::ifstream config_file(request.value("path", config_path));
+            if (!config_file) {
+                return error_response("unable to open bench config");
+            }
+            nlohmann::json config_json;
+            config_file >> config_json;
+            BenchConfig bench_config(config_json);
+            if (!setLoad(bench_config.load)) {
+                return error_response("load cannot be changed");
+            }
+            response["applied"] = {"load"};
+        } else {
+            return error_response("unknown command: " + command);
+        }
+    } catch (const std::exception& e) {
+        return error_response(e.what());
+    }
+    return response;
+}
+
+/**
+ * Start the run on all nodes at the given time.
+ */
+void
+Controller::start(uint64_t start_cycles)
+{
+    for (Benchmark* node : nodes) {
+        node->begin_run(start_cycles);
+    }
+}
+
+/**
+ * Tell all nodes to stop.
+ */
+void
+Controller::stop()
+{
+    for (Benchmark* node : nodes) {
+        node->stop();
+    }
+    running = false;
+}
+
+/**
+ * Dump the stats of all nodes under the given label.
+ */
+void
+Controller::snapshot(const std::string& label)
+{
+    for (Benchmark* node : nodes) {
+        node->dump_stats(label);
+    }
+}
+
+/**
+ * Change the load offered by all nodes; returns false if any node cannot
+ * change its load.
+ */
+bool
+Controller::setLoad(double load)
+{
+    bool changed = true;
+    for (Benchmark* node : nodes) {
+        changed = node->set_load(load) && changed;
+    }
+    return changed;
+}
+
+/**
+ * Return the latency percentiles of the ops each node completed since the
+ * previous latency request keyed by node name.
+ */
+nlohmann::json
+Controller::latency(const std::vector<double>& percentiles)
+{
+    nlohmann::json latency = nlohmann::json::object();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        Histogram const snapshot = nodes.at(i)->client_latency();
+        Histogram histogram = snapshot;
+        histogram.subtract(latency_snapshots.at(i));
+        latency_snapshots.at(i) = snapshot;
+
+        nlohmann::json node_latency;
+        node_latency["samples"] = histogram.count();
+        node_latency["unit"] = "ns";
+        std::vector<nlohmann::json> percentile_json_list;
+        for (double percentile : percentiles) {
+            nlohmann::json percentile_json;
+            percentile_json["percentile"] = percentile;
+            if (histogram.count() > 0) {
+                percentile_json["latency"] = histogram.percentile(percentile);
+            }
+            percentile_json_list.push_back(percentile_json);
+        }
+        node_latency["percentiles"] = nlohmann::json(percentile_json_list);
+        latency[nodes.at(i)->server_name] = node_latency;
+    }
+    return latency;
+}
+
+/**
+ * Return the status of all nodes keyed by node name.
+ */
+nlohmann::json
+Controller::status()
+{
+    nlohmann::json status = nlohmann::json::object();
+    for (Benchmark* node : nodes) {
+        status[node->server_name] = node->get_status();
+    }
+    return status;
+}
+
+/**
+ * Follow the measurement windows of all nodes; the controller stops once
+ * every node is done.
+ *
+ * @return
+ *      Time of the next window boundary of any node; 0 if there is none.
+ */
+uint64_t
+Controller::advanceWindows()
+{
+    uint64_t deadline = 0;
+    bool done = true;
+    for (Benchmark* node : nodes) {
+        uint64_t next = node->advance_windows();
+        if (next != 0 && (deadline == 0 || next < deadline)) {
+            deadline = next;
+        }
+        done = done && node->run_state == Benchmark::RunState::DONE;
+    }
+    if (done) {
+        running = false;
+    }
+    return deadline;
+}
+
+}  // namespace RooBench
@@ -0,0 +1,118 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_CONTROLLER_H
+#define ROOBENCH_CONTROLLER_H
+
+#include <signal.h>
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+
+namespace RooBench {
+
+/**
+ * Drives the benchmark nodes running in this process.
+ *
+ * The controller starts and stops the runs of its nodes, takes their stats
+ * snapshots and changes their load in response to signals, to the nodes'
+ * self-timed measurement windows, and to requests received on a local
+ * control socket.
+ *
+ * Signals: SIGUSR1 starts the run, SIGUSR2 takes a numbered snapshot, and
+ * SIGINT stops the benchmark.
+ *
+ * Control socket: a UNIX-domain stream socket on which each request is a
+ * single line holding a JSON object with a "command" field and each response
+ * is a single line holding a JSON object with an "ok" field (and an "error"
+ * field if "ok" is false).  Supported commands:
+ *
+ *  - {"command": "start", "at": <seconds since the epoch>}  ("at" is
+ *    optional; the run starts at the given wall-clock time, which lets
+ *    several nodes start together, or immediately without it)
+ *  - {"command": "stop"}
+ *  - {"command": "snapshot", "name": <label>}  ("name" is optional; a
+ *    purely numeric name is rejected since the numbered dumps use those)
+ *  - {"command": "set-load", "load": <ops/sec>}
+ *  - {"command": "status"}
+ *  - {"command": "latency", "percentiles": [<p>, ...]}  (reports the
+ *    latency percentiles of the ops completed since the previous latency
+ *    request)
+ *  - {"command": "reload", "path": <bench_config>}  ("path" is optional)
+ */
+class Controller {
+  public:
+    Controller(std::vector<Benchmark*> nodes, const std::string& control_path,
+               const std::string& config_path);
+    ~Controller();
+    void run();
+
+  private:
+    /**
+     * An open connection on the control socket.
+     */
+    struct Connection {
+        /// Socket file descriptor of the connection.
+        int fd;
+
+        /// Received bytes that do not form a complete request yet.
+        std::string buffer;
+    };
+
+    void handleSignal(int sig);
+    void handleConnection(Connection* connection);
+    nlohmann::json handleRequest(const std::string& line);
+    void start(uint64_t start_cycles);
+    void stop();
+    void snapshot(const std::string& label);
+    bool setLoad(double load);
+    nlohmann::json status();
+    nlohmann::json latency(const std::vector<double>& percentiles);
+    uint64_t advanceWindows();
+
+    /// Nodes driven by this controller.
+    const std::vector<Benchmark*> nodes;
+
+    /// Path of the control socket; empty if there is none.
+    std::string control_path;
+
+    /// Path of the bench config used by the reload command by default.
+    const std::string config_path;
+
+    /// Signals handled by the controller.
+    sigset_t sigset;
+
+    /// File descriptor through which the blocked signals are received.
+    int signal_fd;
+
+    /// Listening control socket; -1 if there is none.
+    int listen_fd;
+
+    /// Open connections on the control socket.
+    std::vector<Connection> connections;
+
+    /// Latency histogram of each node at the previous latency request.
+    std::vector<Histogram> latency_snapshots;
+
+    /// False once the benchmark has been told to stop.
+    bool running;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_CONTROLLER_H
@@ -0,0 +1,77 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_COUNTER_H
+#define ROOBENCH_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace RooBench {
+
+/// Size in bytes of a cache line.  Stats written by different threads are
+/// aligned to it so that the threads never write the same cache line.
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Event counter with a single writer.
+ *
+ * Like a Histogram, a counter is updated with relaxed loads and stores
+ * rather than atomic read-modify-write instructions, which would have to
+ * gain exclusive ownership of the cache line.  Other threads may read the
+ * counter at any time.  Counts shared by several threads are kept in
+ * per-thread shards that are summed when the stats are read.
+ */
+class Counter {
+  public:
+    Counter()
+        : value(0)
+    {}
+
+    /**
+     * Add the given amount to the counter.  Must only be called by the
+     * counter's writer.
+     */
+    void add(uint64_t amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount,
+                    std::memory_order_relaxed);
+    }
+
+    /**
+     * Count one event.  Must only be called by the counter's writer.
+     */
+    Counter& operator++()
+    {
+        add(1);
+        return *this;
+    }
+
+    /**
+     * Return the current count; may be called by any thread.
+     */
+    uint64_t load() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> value;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_COUNTER_H
@@ -16,17 +16,20 @@
 #ifndef ROOBENCH_DPCBENCHMARK_H
 #define ROOBENCH_DPCBENCHMARK_H
 
-#include <Homa/Drivers/DPDK/DpdkDriver.h>
 #include <Homa/Homa.h>
 #include <Roo/Roo.h>
 
-#include <array>
 #include <atomic>
-#include <mutex>
+#include <deque>
+#include <random>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "Benchmark.h"
+#include "ClientShard.h"
+#include "Counter.h"
+#include "PayloadArena.h"
 
 // Forward Declarations
 namespace Homa {
@@ -47,26 +50,27 @@ namespace RooBench {
 class DpcBenchmark : public Benchmark {
   public:
     DpcBenchmark(nlohmann::json bench_config, std::string server_name,
-                 std::string output_dir, size_t num_threads);
+                 std::string output_dir, size_t num_threads,
+                 Homa::Driver* homa_driver);
     virtual ~DpcBenchmark();
 
   protected:
     /**
      * Runs the actual benchmark logic.  Multiple instances may exist.
      */
-    virtual void run_benchmark();
+    virtual void run_benchmark(const ThreadInfo& info);
 
     /**
      * Called when the benchmark should dump the current statistics.
      *
      * Implemented by Benchmark subclasses.  Must be thread-safe.
      */
-    virtual void dump_stats();
+    virtual void dump_stats(const std::string& label);
 
     /**
      * Signal that the benchmark client should start running.
      */
-    virtual void start_client();
+    virtual void start_client(uint64_t start_cycles);
 
     /**
      * Signal to the subclass that all instacnes of run_benchmark() should
@@ -74,60 +78,284 @@ class DpcBenchmark : public Benchmark {
      */
     virtual void stop();
 
+    /**
+     * Change the load offered by the benchmark client while it runs.
+     */
+    virtual bool set_load(double load);
+
+    /**
+     * Returns benchmark specific progress information for status requests.
+     */
+    virtual nlohmann::json status();
+
+    /**
+     * Returns the latency histogram of the client ops completed so far.
+     */
+    virtual Histogram client_latency();
+
+    /**
+     * Returns the number of client ops dropped so far.
+     */
+    virtual uint64_t client_drops();
+
+    /**
+     * Add the benchmark's counters to a sample of the stats.
+     */
+    virtual void sample_stats(StatsSink& out, const std::string& prefix);
+
+    /**
+     * Returns the number of ops of the measurement window still in flight.
+     */
+    virtual uint64_t in_window_outstanding();
+
+    /**
+     * Returns true if this node runs a benchmark client.
+     */
+    virtual bool is_client_node() const
+    {
+        return client_node;
+    }
+
   private:
-    static const uint64_t SAMPLE_INDEX_MASK = 0x0FFFFF;
-    static const uint64_t MAX_SAMPLES = SAMPLE_INDEX_MASK + 1;
-
-    struct ClientStats {
-        std::atomic<int> count;
-        std::atomic<int> failures;
-        std::atomic<int> drops;
-        std::atomic<uint64_t> sample_count;
-        std::array<std::atomic<uint64_t>, MAX_SAMPLES> samples;
+    /**
+     * Server task stats written by a single benchmark thread.
+     */
+    struct alignas(CACHE_LINE_SIZE) TaskShard {
+        /// Number of requests handled.
+        Counter count;
+
+        /// Time in nanoseconds the handler spent processing the requests.
+        Histogram service;
+
+        /// Size in bytes of the requests.
+        Histogram request_bytes;
+
+        /// Size in bytes of the responses.
+        Histogram response_bytes;
     };
     struct TaskStats {
-        std::atomic<int> count;
+        explicit TaskStats(size_t shard_count)
+            : shards(shard_count)
+        {}
+
+        /// Stats of the task indexed by the id of the benchmark thread that
+        /// handled it.
+        std::vector<TaskShard> shards;
+    };
+    /**
+     * CPU accounting of a single benchmark thread, written only by that
+     * thread.
+     */
+    struct alignas(CACHE_LINE_SIZE) ThreadStats {
+        ThreadStats()
+            : total_cycles()
+            , client_active_cycles()
+            , server_active_cycles()
+            , idle_poll_cycles()
+            , polls()
+            , poll_gap()
+            , last_poll_cycles(0)
+        {}
+
+        /// Cycles the thread spent in its benchmark loop.
+        Counter total_cycles;
+
+        /// Cycles spent issuing and completing client ops.
+        Counter client_active_cycles;
+
+        /// Cycles spent receiving and handling server tasks.
+        Counter server_active_cycles;
+
+        /// Cycles of the loop iterations that found neither client nor
+        /// server work to do; the rest of the total not counted as active
+        /// was spent polling the socket in busy iterations.
+        Counter idle_poll_cycles;
+
+        /// Number of times the thread polled the socket.
+        Counter polls;
+
+        /// Time in nanoseconds between the starts of two successive polls of
+        /// the socket.
+        Histogram poll_gap;
+
+        /// Time at which the thread last polled the socket; 0 before its
+        /// first poll.  Only accessed by the thread itself.
+        uint64_t last_poll_cycles;
+    };
+    struct Peer {
+        /// Address to which requests for the server are sent.
+        Homa::Driver::Address address;
+        /// Name of the server in the server list.
+        std::string name;
+    };
+    struct LoadStep {
+        /// Cycles after the client start at which the step ends.
+        uint64_t stopCycles;
+        /// Mean cycles between two ops issued by this node; 0 if the step
+        /// offers no load.
+        uint64_t cyclesPerOp;
     };
     struct Op {
         Op()
             : rpc()
             , nextPhase()
+            , phase_cycles()
+            , phase_peers()
+            , step(0)
             , start_cycles(0)
             , stop_cycles(0)
         {}
 
         Roo::unique_ptr<Roo::RooPC> rpc;
         std::vector<BenchConfig::Client::Phase>::const_iterator nextPhase;
+        std::vector<uint64_t> phase_cycles;
+        /// Indexes in peer_list of the servers each phase sent requests to.
+        std::vector<std::vector<size_t>> phase_peers;
+        size_t step;
         uint64_t start_cycles;
         uint64_t stop_cycles;
     };
 
+    /**
+     * Client load generator owned by a single benchmark thread.  Each
+     * generator issues its share of the node's load and tracks its own ops
+     * independently of the other generators.
+     */
+    struct Generator {
+        Generator(uint64_t generators, bool closedLoop, int concurrency,
+                  uint64_t thinkCycles, ClientShard* stats)
+            : generators(generators)
+            , gen(std::random_device()())
+            , dis()
+            , started(false)
+            , step(0)
+            , loadVersion(0)
+            , nextOpTimeout(0)
+            , queueDepth(0)
+            , closedLoop(closedLoop)
+            , concurrency(concurrency)
+            , thinkCycles(thinkCycles)
+            , slotTimeouts()
+            , backlog()
+            , ops()
+            , stats(stats)
+        {}
+
+        ~Generator()
+        {
+            for (Op* op : backlog) {
+                delete op;
+            }
+            for (Op* op : ops) {
+                delete op;
+            }
+        }
+
+        /// Number of generators that share the node's load.
+        uint64_t generators;
+
+        /// Source of randomness for the op inter-arrival times.
+        std::mt19937 gen;
+
+        /// Distribution of the cycles between two ops of this generator.
+        std::poisson_distribution<uint64_t> dis;
+
+        /// True once the generator has seen the client start.
+        bool started;
+
+        /// Index of the load step the generator is in.
+        size_t step;
+
+        /// Version of the load set through set_load() that the generator
+        /// follows; 0 while it follows the load schedule.
+        uint64_t loadVersion;
+
+        /// Time at which the next open-loop op should be issued.
+        uint64_t nextOpTimeout;
+
+        /// Maximum number of open-loop ops this generator keeps in flight;
+        /// ops offered while the limit is reached wait in the backlog, which
+        /// holds as many ops, and are dropped once the backlog is full.
+        std::size_t queueDepth;
+
+        /// True if the generator runs closed loop; the mode is the same for
+        /// all generators of the node.
+        bool closedLoop;
+
+        /// Number of ops this generator keeps in flight in the closed-loop
+        /// mode; a closed-loop generator whose share of the node's
+        /// concurrency is 0 issues no ops.
+        int concurrency;
+
+        /// Cycles a closed-loop slot waits after its op completes before it
+        /// issues the next op.
+        uint64_t thinkCycles;
+
+        /// Times at which the idle closed-loop slots may issue their next op
+        /// in increasing order.
+        std::deque<uint64_t> slotTimeouts;
+
+        /// Open-loop ops that arrived while queueDepth ops were in flight;
+        /// they are issued in arrival order as ops complete.
+        std::deque<Op*> backlog;
+
+        /// Ops issued by this generator that have not yet completed.
+        std::deque<Op*> ops;
+
+        /// Stats in which this generator records its ops.
+        ClientShard* stats;
+    };
+
+    static std::vector<Peer> create_peer_list(
+        const BenchConfig::ServerList& server_list, Homa::Driver* driver);
     static std::unordered_map<int, const std::unique_ptr<TaskStats>>
-    create_task_stats_map(const BenchConfig::TaskMap& task_map);
+    create_task_stats_map(const BenchConfig::TaskMap& task_map,
+                          std::size_t shard_count);
+    static std::vector<LoadStep> create_schedule(const BenchConfig& config);
+    static std::vector<std::unique_ptr<ClientShard>> create_client_shards(
+        std::size_t shard_count, std::size_t step_count,
+        std::size_t phase_count, std::size_t peer_count);
+    static uint64_t task_total(const TaskStats& stats);
 
-    void server_poll();
-    void client_poll();
-    Homa::Driver::Address selectServer();
-    void dispatch(Roo::unique_ptr<Roo::ServerTask> task);
-    void handleBenchmarkTask(Roo::unique_ptr<Roo::ServerTask> task);
+    uint64_t client_total(Counter ClientCounters::*counter) const;
+    uint64_t step_total(size_t step, Counter StepCounters::*counter) const;
+    uint64_t peer_total(size_t peer, Counter PeerCounters::*counter) const;
+    void write_transport_stats(StatsSink& out, const std::string& prefix);
+    uint64_t thread_total(Counter ThreadStats::*counter) const;
+    void poll_socket(ThreadStats* stats);
+    bool server_poll(size_t thread);
+    bool client_poll(Generator* generator, size_t thread);
+    void start_step(Generator* generator, size_t step, uint64_t start_cycles);
+    void set_rate(Generator* generator, uint64_t cycles_per_op,
+                  uint64_t start_cycles);
+    std::size_t queue_depth(uint64_t generators, uint64_t cycles_per_op) const;
+    size_t selectServer();
+    void dispatch(Roo::unique_ptr<Roo::ServerTask> task, size_t thread);
+    void handleBenchmarkTask(Roo::unique_ptr<Roo::ServerTask> task,
+                             size_t thread);
 
     const std::unique_ptr<Homa::Driver> driver;
     const std::unique_ptr<Homa::Transport> transport;
     const std::unique_ptr<Roo::Socket> socket;
-    const std::vector<Homa::Driver::Address> peer_list;
+    const std::vector<Peer> peer_list;
     const bool unified;
-    const std::size_t queueDepth;
-    const uint64_t cyclesPerOp;
-    std::atomic<uint64_t> nextOpTimeout;
+    /// True if this node runs a client; initialized before the per-thread
+    /// state below since thread_count() depends on it.
+    const bool client_node;
+    const std::vector<LoadStep> schedule;
+    const PayloadArena payloads;
+    std::atomic<uint64_t> client_start_cycles;
     std::atomic<bool> run;
     std::atomic<bool> run_client;
-    std::atomic_flag client_running;
+    std::atomic<double> load_override;
+    std::atomic<uint64_t> load_override_cycles;
+    std::atomic<uint64_t> load_override_version;
 
-    std::mutex stats_mutex;
-    ClientStats client_stats;
     const std::unordered_map<int, const std::unique_ptr<TaskStats>> task_stats;
+    const std::vector<std::unique_ptr<ClientShard>> client_shards;
 
-    std::atomic<uint64_t> active_cycles;
+    /// CPU accounting of each benchmark thread indexed by the thread's id.
+    std::vector<ThreadStats> thread_stats;
 };
 
 }  // namespace RooBench
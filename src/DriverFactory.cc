@@ -0,0 +1,63 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "DriverFactory.h"
+
+#include <Homa/Drivers/DPDK/DpdkDriver.h>
+#include <Homa/Drivers/Fake/FakeDriver.h>
+
+#include <stdexcept>
+
+#include "UdpDriver.h"
+
+namespace RooBench {
+namespace DriverFactory {
+
+/**
+ * Create and return a new Homa::Driver based on the given configuration.
+ *
+ * @param driver_config
+ *      Driver section of the benchmark configuration.
+ * @return
+ *      The newly constructed driver; the caller takes ownership.
+ * @throw std::invalid_argument
+ *      If the configured driver type is unknown.
+ */
+Homa::Driver*
+createDriver(const BenchConfig::Driver& driver_config)
+{
+    if (driver_config.type == "dpdk") {
+        Homa::Drivers::DPDK::DpdkDriver::Config config;
+        config.HIGHEST_PACKET_PRIORITY_OVERRIDE =
+            driver_config.priorityOverride;
+        return new Homa::Drivers::DPDK::DpdkDriver(driver_config.port, &config);
+    } else if (driver_config.type == "fake") {
+        return new Homa::Drivers::Fake::FakeDriver();
+    } else if (driver_config.type == "udp") {
+        UdpDriver::Config config;
+        config.interface = driver_config.interface;
+        config.port = driver_config.port;
+        config.batchSize = driver_config.batchSize;
+        config.gso = driver_config.gso;
+        config.bandwidth = driver_config.bandwidth;
+        return new UdpDriver(config);
+    } else {
+        throw std::invalid_argument("Unknown driver type '" +
+                                    driver_config.type + "'");
+    }
+}
+
+}  // namespace DriverFactory
+}  // namespace RooBench
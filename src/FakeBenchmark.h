@@ -65,7 +65,7 @@ class FakeBenchmark : public Benchmark {
     /**
      * Runs the actual benchmark logic.  Multiple instances may exist.
      */
-    virtual void run_benchmark()
+    virtual void run_benchmark(const ThreadInfo& info)
     {
         Test::temp.x = 1;
         for (int i = 1; i < 30; ++i) {
@@ -86,16 +86,16 @@ class FakeBenchmark : public Benchmark {
      *
      * Implemented by Benchmark subclasses.  Must be thread-safe.
      */
-    virtual void dump_stats()
+    virtual void dump_stats(const std::string& label)
     {
         std::lock_guard<std::mutex> lock(mutex);
-        std::cout << "stats" << std::endl;
+        std::cout << "stats " << label << std::endl;
     };
 
     /**
      * Signal that the benchmark client should start running.
      */
-    virtual void start_client()
+    virtual void start_client(uint64_t start_cycles)
     {
         std::lock_guard<std::mutex> lock(mutex);
         std::cout << "start" << std::endl;
@@ -111,6 +111,64 @@ class FakeBenchmark : public Benchmark {
         run = false;
     }
 
+    /**
+     * Change the load offered by the benchmark client while it runs.
+     */
+    virtual bool set_load(double load)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "load " << load << std::endl;
+        return true;
+    }
+
+    /**
+     * Returns benchmark specific progress information for status requests.
+     */
+    virtual nlohmann::json status()
+    {
+        return nlohmann::json::object();
+    }
+
+    /**
+     * Returns the latency histogram of the client ops completed so far.
+     */
+    virtual Histogram client_latency()
+    {
+        return Histogram();
+    }
+
+    /**
+     * Returns the number of client ops dropped so far.
+     */
+    virtual uint64_t client_drops()
+    {
+        return 0;
+    }
+
+    /**
+     * Add the benchmark's counters to a sample of the stats.
+     */
+    virtual void sample_stats(StatsSink& out, const std::string& prefix)
+    {
+        out.counter(prefix + "/count", 0);
+    }
+
+    /**
+     * Returns the number of ops of the measurement window still in flight.
+     */
+    virtual uint64_t in_window_outstanding()
+    {
+        return 0;
+    }
+
+    /**
+     * Returns true if this node runs a benchmark client.
+     */
+    virtual bool is_client_node() const
+    {
+        return true;
+    }
+
   private:
     std::mutex mutex;
     bool run;
@@ -0,0 +1,218 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace RooBench {
+
+const int Histogram::SUB_BUCKET_BITS;
+const uint64_t Histogram::SUB_BUCKET_COUNT;
+const uint64_t Histogram::SUB_BUCKET_HALF;
+const int Histogram::MAX_VALUE_BITS;
+const uint64_t Histogram::MAX_VALUE;
+const size_t Histogram::BUCKET_COUNT;
+
+/**
+ * Construct an empty histogram.
+ */
+Histogram::Histogram()
+    : counts()
+{
+    for (std::atomic<uint64_t>& count : counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Construct a snapshot of the given histogram.
+ */
+Histogram::Histogram(const Histogram& other)
+    : counts()
+{
+    *this = other;
+}
+
+/**
+ * Replace the counts with a snapshot of the given histogram.
+ */
+Histogram&
+Histogram::operator=(const Histogram& other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i].store(other.counts[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+/**
+ * Return the smallest value counted by the given bucket.
+ */
+uint64_t
+Histogram::bucketLowest(size_t index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    uint64_t const shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF + 1;
+    uint64_t const sub_bucket =
+        (index - SUB_BUCKET_COUNT) % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+    return sub_bucket << shift;
+}
+
+/**
+ * Return the largest value counted by the given bucket.
+ */
+uint64_t
+Histogram::bucketHighest(size_t index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    uint64_t const shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF + 1;
+    return bucketLowest(index) + (1UL << shift) - 1;
+}
+
+/**
+ * Return the value that represents all values counted by the given bucket:
+ * the middle of the bucket.
+ */
+uint64_t
+Histogram::bucketValue(size_t index)
+{
+    uint64_t const lowest = bucketLowest(index);
+    return lowest + (bucketHighest(index) - lowest) / 2;
+}
+
+/**
+ * Add the counts of the given histogram to this histogram.  Must only be
+ * called by the histogram's writer.
+ */
+void
+Histogram::merge(const Histogram& other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i].store(counts[i].load(std::memory_order_relaxed) +
+                            other.counts[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Remove the counts of the given histogram, an earlier snapshot of this
+ * histogram, from this histogram.  Must only be called by the histogram's
+ * writer.
+ */
+void
+Histogram::subtract(const Histogram& other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        uint64_t const count = counts[i].load(std::memory_order_relaxed);
+        uint64_t const other_count =
+            other.counts[i].load(std::memory_order_relaxed);
+        counts[i].store(count > other_count ? count - other_count : 0,
+                        std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Return the number of recorded values.
+ */
+uint64_t
+Histogram::count() const
+{
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& count : counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * Return the number of recorded values counted by the given bucket.
+ */
+uint64_t
+Histogram::count(size_t index) const
+{
+    return counts[index].load(std::memory_order_relaxed);
+}
+
+/**
+ * Return the sum of the recorded values, approximated by counting each value
+ * as the middle of its bucket.
+ */
+uint64_t
+Histogram::sum() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        total += count(i) * bucketValue(i);
+    }
+    return total;
+}
+
+/**
+ * Return the given percentile of the recorded values (nearest rank); 0 if
+ * no values were recorded.
+ */
+uint64_t
+Histogram::percentile(double percentile) const
+{
+    uint64_t const total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t const rank = std::max<uint64_t>(
+        1, std::min<uint64_t>(std::ceil(percentile / 100.0 * total), total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return bucketValue(i);
+        }
+    }
+    return bucketValue(BUCKET_COUNT - 1);
+}
+
+/**
+ * Return the histogram in its serialized form: the layout parameters and a
+ * flat list of (bucket index, count) pairs for the nonempty buckets.
+ */
+nlohmann::json
+Histogram::toJson() const
+{
+    std::vector<uint64_t> buckets;
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        uint64_t const count = counts[i].load(std::memory_order_relaxed);
+        if (count != 0) {
+            buckets.push_back(i);
+            buckets.push_back(count);
+            total += count;
+        }
+    }
+    nlohmann::json histogram;
+    histogram["sub_bucket_bits"] = SUB_BUCKET_BITS;
+    histogram["max_value_bits"] = MAX_VALUE_BITS;
+    histogram["count"] = total;
+    histogram["buckets"] = nlohmann::json(buckets);
+    return histogram;
+}
+
+}  // namespace RooBench
@@ -0,0 +1,107 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_HISTOGRAM_H
+#define ROOBENCH_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+namespace RooBench {
+
+/**
+ * Fixed-size histogram with logarithmically sized buckets (HDR histogram
+ * layout).
+ *
+ * Values below SUB_BUCKET_COUNT have a bucket each; above, every power of two
+ * is split into SUB_BUCKET_COUNT / 2 equal buckets.  A bucket thus spans less
+ * than 1/128th of its values, which bounds the error of every percentile
+ * regardless of how many values were recorded.  Values above MAX_VALUE are
+ * counted in the last bucket.  Histograms with the same layout can be merged
+ * and subtracted bucket by bucket.
+ *
+ * A histogram has a single writer: record() updates the counts with relaxed
+ * loads and stores rather than atomic read-modify-write instructions.  Other
+ * threads may copy or merge the histogram at any time and see each count
+ * either before or after a concurrent update.
+ */
+class Histogram {
+  public:
+    /// Number of bits of a value that select its bucket.
+    static const int SUB_BUCKET_BITS = 8;
+    static const uint64_t SUB_BUCKET_COUNT = 1UL << SUB_BUCKET_BITS;
+    static const uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+
+    /// Largest value with its own bucket.
+    static const int MAX_VALUE_BITS = 40;
+    static const uint64_t MAX_VALUE = (1UL << MAX_VALUE_BITS) - 1;
+
+    static const size_t BUCKET_COUNT =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    Histogram();
+    Histogram(const Histogram& other);
+    Histogram& operator=(const Histogram& other);
+
+    /**
+     * Count one occurrence of the given value.  Must only be called by the
+     * histogram's writer.
+     */
+    void record(uint64_t value)
+    {
+        std::atomic<uint64_t>& count = counts[bucketIndex(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    /**
+     * Return the index of the bucket that counts the given value.
+     */
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT) {
+            return value;
+        }
+        if (value > MAX_VALUE) {
+            value = MAX_VALUE;
+        }
+        // The shift leaves the SUB_BUCKET_BITS most significant bits.
+        int const shift = 64 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF +
+               (value >> shift) - SUB_BUCKET_HALF;
+    }
+
+    static uint64_t bucketLowest(size_t index);
+    static uint64_t bucketHighest(size_t index);
+    static uint64_t bucketValue(size_t index);
+
+    void merge(const Histogram& other);
+    void subtract(const Histogram& other);
+    uint64_t count() const;
+    uint64_t count(size_t index) const;
+    uint64_t sum() const;
+    uint64_t percentile(double percentile) const;
+    nlohmann::json toJson() const;
+
+  private:
+    /// Number of recorded values in each bucket.
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_HISTOGRAM_H
@@ -0,0 +1,244 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LiveStats.h"
+
+#include <PerfUtils/Cycles.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "StatsWriter.h"
+
+namespace RooBench {
+
+const uint32_t LiveStats::VERSION;
+const uint32_t LiveStats::ENTRY_CAPACITY;
+const uint32_t LiveStats::HISTOGRAM_CAPACITY;
+const size_t LiveStats::POINTER_LENGTH;
+
+namespace {
+
+/// Magic bytes at the start of every live stats segment.
+const char MAGIC[8] = {'R', 'B', 'L', 'I', 'V', 'E', '\0', '\0'};
+
+// Readers in other processes rely on the documented layout.
+static_assert(sizeof(LiveStats::Header) == 136, "Unexpected header size");
+static_assert(sizeof(LiveStats::Entry) == 128, "Unexpected entry size");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared atomics must be lock-free");
+
+/**
+ * Copy a pointer into a fixed size, zero padded field.
+ */
+void
+copyPointer(char* field, const std::string& pointer)
+{
+    std::memset(field, 0, LiveStats::POINTER_LENGTH);
+    std::memcpy(field, pointer.data(), pointer.size());
+}
+
+}  // namespace
+
+/**
+ * Create the segment of the given server, replacing any segment left
+ * behind by an earlier process of the same name.
+ *
+ * Failures are reported on stderr and leave the LiveStats invalid; its
+ * methods then do nothing.
+ *
+ * @param server_name
+ *      Name of the server running the benchmark.
+ */
+LiveStats::LiveStats(const std::string& server_name)
+    : name("/roobench." + server_name)
+    , size(sizeof(Header) + ENTRY_CAPACITY * sizeof(Entry) +
+           HISTOGRAM_CAPACITY * sizeof(HistogramSlot))
+    , header(nullptr)
+    , entries(nullptr)
+    , histograms(nullptr)
+    , entry_indexes()
+    , histogram_indexes()
+{
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to create the live stats segment " << name
+                  << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int const error = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Unable to map the live stats segment " << name << ": "
+                  << std::strerror(error) << std::endl;
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    // The segment is zero-filled; only the constant fields need to be set.
+    header = static_cast<Header*>(addr);
+    entries = reinterpret_cast<Entry*>(header + 1);
+    histograms = reinterpret_cast<HistogramSlot*>(entries + ENTRY_CAPACITY);
+    header->version = VERSION;
+    header->entry_capacity = ENTRY_CAPACITY;
+    header->histogram_capacity = HISTOGRAM_CAPACITY;
+    header->bucket_count = Histogram::BUCKET_COUNT;
+    header->sub_bucket_bits = Histogram::SUB_BUCKET_BITS;
+    header->max_value_bits = Histogram::MAX_VALUE_BITS;
+    header->pid = getpid();
+    header->cycles_per_second = PerfUtils::Cycles::perSecond();
+    std::strncpy(header->server_name, server_name.c_str(),
+                 sizeof(header->server_name) - 1);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+}
+
+/**
+ * Unmap and remove the segment.
+ */
+LiveStats::~LiveStats()
+{
+    if (header != nullptr) {
+        munmap(header, size);
+        shm_unlink(name.c_str());
+    }
+}
+
+/**
+ * Start a publication; readers ignore the segment until end() is called.
+ * Values may only be added between begin() and end().
+ */
+void
+LiveStats::begin()
+{
+    if (header == nullptr) {
+        return;
+    }
+    uint64_t const sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * Complete the publication started by begin().
+ */
+void
+LiveStats::end()
+{
+    if (header == nullptr) {
+        return;
+    }
+    header->timestamp.store(PerfUtils::Cycles::rdtsc(),
+                            std::memory_order_relaxed);
+    uint64_t const sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_release);
+}
+
+/**
+ * @copydoc StatsSink::counter()
+ */
+void
+LiveStats::counter(const std::string& pointer, uint64_t value)
+{
+    Entry* entry =
+        findEntry(pointer, static_cast<uint32_t>(StatsWriter::Type::UINT));
+    if (entry != nullptr) {
+        entry->value.store(value, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @copydoc StatsSink::number()
+ */
+void
+LiveStats::number(const std::string& pointer, double value)
+{
+    Entry* entry =
+        findEntry(pointer, static_cast<uint32_t>(StatsWriter::Type::DOUBLE));
+    if (entry != nullptr) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        entry->value.store(bits, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @copydoc StatsSink::histogram()
+ */
+void
+LiveStats::histogram(const std::string& pointer, const Histogram& histogram)
+{
+    if (header == nullptr) {
+        return;
+    }
+    HistogramSlot* slot = nullptr;
+    auto it = histogram_indexes.find(pointer);
+    if (it != histogram_indexes.end()) {
+        slot = &histograms[it->second];
+    } else {
+        uint32_t const index =
+            header->histogram_count.load(std::memory_order_relaxed);
+        if (pointer.size() >= POINTER_LENGTH || index >= HISTOGRAM_CAPACITY) {
+            return;
+        }
+        slot = &histograms[index];
+        copyPointer(slot->pointer, pointer);
+        histogram_indexes.emplace(pointer, index);
+        header->histogram_count.store(index + 1, std::memory_order_relaxed);
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+        uint64_t const count = histogram.count(i);
+        slot->counts[i].store(count, std::memory_order_relaxed);
+        total += count;
+    }
+    slot->count = total;
+}
+
+/**
+ * Return the entry of the given value, adding it if it is new; nullptr if
+ * the value cannot be published.
+ */
+LiveStats::Entry*
+LiveStats::findEntry(const std::string& pointer, uint32_t type)
+{
+    if (header == nullptr) {
+        return nullptr;
+    }
+    auto it = entry_indexes.find(pointer);
+    if (it != entry_indexes.end()) {
+        return &entries[it->second];
+    }
+    uint32_t const index = header->entry_count.load(std::memory_order_relaxed);
+    if (pointer.size() >= POINTER_LENGTH || index >= ENTRY_CAPACITY) {
+        return nullptr;
+    }
+    Entry* entry = &entries[index];
+    copyPointer(entry->pointer, pointer);
+    entry->type = type;
+    entry_indexes.emplace(pointer, index);
+    header->entry_count.store(index + 1, std::memory_order_relaxed);
+    return entry;
+}
+
+}  // namespace RooBench
@@ -0,0 +1,143 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_LIVESTATS_H
+#define ROOBENCH_LIVESTATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "Histogram.h"
+#include "StatsSink.h"
+
+namespace RooBench {
+
+/**
+ * Publishes the stats of a running benchmark in a shared memory segment
+ * (/dev/shm/roobench.<server name>) so that external monitors such as
+ * roobench.py top can read them without involving the benchmark.
+ *
+ * The segment is rewritten as a whole by each publication, which is
+ * bracketed by begin() and end() and protected by a sequence lock: the
+ * sequence number is odd while a publication is in progress, and a reader
+ * that sees the same even sequence number before and after copying the
+ * segment has a consistent copy.  Values are cumulative; readers diff
+ * consecutive copies to get rates.
+ *
+ * Segment layout (version 1; little endian, native alignment):
+ *
+ *   header:     Header (136 bytes)
+ *   entries:    Entry[ENTRY_CAPACITY] (128 bytes each); the first
+ *               entry_count are valid
+ *   histograms: HistogramSlot[HISTOGRAM_CAPACITY]; the first
+ *               histogram_count are valid
+ *
+ * Entry types are those of the StatsWriter records (UINT or DOUBLE).
+ * Values whose pointer does not fit or that exceed the capacity are not
+ * published.  The segment is removed when the LiveStats is destroyed.
+ *
+ * This class is NOT thread-safe; a single thread publishes the stats.
+ */
+class LiveStats : public StatsSink {
+  public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENTRY_CAPACITY = 1024;
+    static const uint32_t HISTOGRAM_CAPACITY = 4;
+    static const size_t POINTER_LENGTH = 112;
+
+    /// Segment header.
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entry_capacity;
+        uint32_t histogram_capacity;
+        uint32_t bucket_count;
+        uint32_t sub_bucket_bits;
+        uint32_t max_value_bits;
+        /// Sequence lock; odd while a publication is in progress.
+        std::atomic<uint64_t> sequence;
+        /// Process id of the publishing benchmark.
+        uint64_t pid;
+        double cycles_per_second;
+        /// Time in cycles of the last publication.
+        std::atomic<uint64_t> timestamp;
+        std::atomic<uint32_t> entry_count;
+        std::atomic<uint32_t> histogram_count;
+        char server_name[64];
+    };
+
+    /// Named value; a double is stored as its bit pattern.
+    struct Entry {
+        char pointer[POINTER_LENGTH];
+        uint32_t type;
+        uint32_t reserved;
+        std::atomic<uint64_t> value;
+    };
+
+    /// Named histogram with the layout given in the header.
+    struct HistogramSlot {
+        char pointer[POINTER_LENGTH];
+        /// Sum of the counts.
+        uint64_t count;
+        uint64_t reserved;
+        std::atomic<uint64_t> counts[Histogram::BUCKET_COUNT];
+    };
+
+    explicit LiveStats(const std::string& server_name);
+    virtual ~LiveStats();
+
+    /// Returns false if the segment could not be created.
+    bool valid() const
+    {
+        return header != nullptr;
+    }
+
+    void begin();
+    void end();
+    virtual void counter(const std::string& pointer, uint64_t value);
+    virtual void number(const std::string& pointer, double value);
+    virtual void histogram(const std::string& pointer,
+                           const Histogram& histogram);
+
+  private:
+    Entry* findEntry(const std::string& pointer, uint32_t type);
+
+    /// Name of the segment as passed to shm_open().
+    const std::string name;
+
+    /// Size in bytes of the segment.
+    const size_t size;
+
+    /// Start of the mapped segment; nullptr if the segment is not mapped.
+    Header* header;
+
+    /// Entries of the segment.
+    Entry* entries;
+
+    /// Histogram slots of the segment.
+    HistogramSlot* histograms;
+
+    /// Index of the entry of each published value.
+    std::unordered_map<std::string, uint32_t> entry_indexes;
+
+    /// Index of the slot of each published histogram.
+    std::unordered_map<std::string, uint32_t> histogram_indexes;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_LIVESTATS_H
@@ -0,0 +1,425 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "MetricsServer.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "StatsSink.h"
+
+namespace RooBench {
+
+namespace {
+
+/// Quantiles reported for each latency summary.
+const double SUMMARY_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+/// Largest HTTP request header accepted.
+const size_t MAX_REQUEST_SIZE = 8192;
+
+/**
+ * Samples of a metric; Prometheus requires them to be contiguous.
+ */
+struct Family {
+    /// Prometheus type of the metric; empty if untyped.
+    std::string type;
+
+    /// Lines holding the samples of the metric.
+    std::vector<std::string> samples;
+};
+
+/**
+ * Return the given string with every character that is not valid in a
+ * metric or label name replaced by an underscore.
+ */
+std::string
+sanitize(const std::string& name)
+{
+    std::string result = name;
+    for (char& c : result) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            c = '_';
+        }
+    }
+    return result;
+}
+
+/**
+ * Return the given label value escaped for the text format.
+ */
+std::string
+escape(const std::string& value)
+{
+    std::string result;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+/**
+ * Return the given quantile of the values recorded in the histogram plus
+ * the given number of infinitely large values, ranked the way
+ * roobench_stats.percentile() ranks them; "+Inf" if it is one of the latter.
+ */
+std::string
+quantile_value(const Histogram& histogram, uint64_t infinite, double quantile)
+{
+    uint64_t const total = histogram.count() + infinite;
+    if (total == 0) {
+        return "0";
+    }
+    uint64_t const rank =
+        std::min<uint64_t>(static_cast<uint64_t>(quantile * total) + 1, total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+        seen += histogram.count(i);
+        if (seen >= rank) {
+            return std::to_string(Histogram::bucketValue(i));
+        }
+    }
+    return "+Inf";
+}
+
+/**
+ * Collects the values of a node's stats sample as Prometheus samples.
+ */
+class PrometheusSink : public StatsSink {
+  public:
+    /**
+     * @param families
+     *      Metrics to which the samples are added, keyed by name.
+     * @param server_name
+     *      Name of the node the sample belongs to.
+     */
+    PrometheusSink(std::map<std::string, Family>* families,
+                   const std::string& server_name)
+        : families(families)
+        , server_label("server=\"" + escape(server_name) + "\"")
+    {}
+
+    virtual void counter(const std::string& pointer, uint64_t value)
+    {
+        add(pointer, "", "", std::to_string(value));
+        (*families)[name(pointer, nullptr)].type = "counter";
+    }
+
+    virtual void gauge(const std::string& pointer, uint64_t value)
+    {
+        add(pointer, "", "", std::to_string(value));
+        (*families)[name(pointer, nullptr)].type = "gauge";
+    }
+
+    virtual void number(const std::string& pointer, double value)
+    {
+        std::ostringstream out;
+        out.precision(17);
+        out << value;
+        add(pointer, "", "", out.str());
+    }
+
+    virtual void histogram(const std::string& pointer,
+                           const Histogram& histogram)
+    {
+        summary(pointer, histogram, 0);
+    }
+
+    /**
+     * Add a summary of the given latency histogram in which the given
+     * number of dropped ops count as infinitely slow, as roobench.py stats
+     * and top count them; otherwise an overloaded client would report the
+     * latency of the few ops it still managed to issue.  The sum and count
+     * only cover the recorded values.
+     */
+    void summary(const std::string& pointer, const Histogram& histogram,
+                 uint64_t drops)
+    {
+        for (double quantile : SUMMARY_QUANTILES) {
+            std::ostringstream label;
+            label << "quantile=\"" << quantile << "\"";
+            add(pointer, "", label.str(),
+                quantile_value(histogram, drops, quantile));
+        }
+        add(pointer, "_sum", "", std::to_string(histogram.sum()));
+        add(pointer, "_count", "", std::to_string(histogram.count()));
+        (*families)[name(pointer, nullptr)].type = "summary";
+    }
+
+  private:
+    /**
+     * Return the metric name of the given pointer and, if labels is not
+     * nullptr, append the labels taken from its numeric components.
+     */
+    std::string name(const std::string& pointer, std::string* labels)
+    {
+        std::string result = "roobench";
+        std::string previous;
+        std::istringstream components(pointer);
+        std::string component;
+        while (std::getline(components, component, '/')) {
+            if (component.empty()) {
+                continue;
+            }
+            if (component.find_first_not_of("0123456789") ==
+                    std::string::npos &&
+                !previous.empty()) {
+                if (labels != nullptr) {
+                    *labels += "," + sanitize(previous) + "=\"" + component +
+                               "\"";
+                }
+            } else {
+                result += "_" + sanitize(component);
+            }
+            previous = component;
+        }
+        return result;
+    }
+
+    /**
+     * Add a sample of the metric of the given pointer.
+     */
+    void add(const std::string& pointer, const std::string& suffix,
+             const std::string& extra_label, const std::string& value)
+    {
+        std::string labels = server_label;
+        std::string const metric = name(pointer, &labels);
+        if (!extra_label.empty()) {
+            labels += "," + extra_label;
+        }
+        (*families)[metric].samples.push_back(metric + suffix + "{" +
+                                              labels + "} " + value);
+    }
+
+    /// Metrics to which the samples are added, keyed by name.
+    std::map<std::string, Family>* families;
+
+    /// Label identifying the node of the samples.
+    const std::string server_label;
+};
+
+}  // namespace
+
+/**
+ * Start serving the stats of the given nodes.
+ *
+ * Failures are reported on stderr and leave the server stopped.  Construct
+ * the server after the Controller so that its thread inherits the blocked
+ * signals.
+ *
+ * @param nodes
+ *      The benchmark nodes whose stats should be served.
+ * @param address
+ *      Address to listen on as [<host>:]<port>; the host defaults to
+ *      127.0.0.1 so that the stats are not exposed beyond this machine
+ *      unless asked for.
+ */
+MetricsServer::MetricsServer(std::vector<Benchmark*> nodes,
+                             const std::string& address)
+    : nodes(std::move(nodes))
+    , listen_fd(-1)
+    , running(true)
+    , thread()
+{
+    std::string host = "127.0.0.1";
+    std::string port = address;
+    size_t const colon = address.rfind(':');
+    if (colon != std::string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+        // Strip the brackets of an IPv6 address.
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* info = nullptr;
+    int const error = getaddrinfo(host.c_str(), port.c_str(), &hints, &info);
+    if (error != 0) {
+        std::cerr << "Invalid metrics address " << address << ": "
+                  << gai_strerror(error) << std::endl;
+        return;
+    }
+    listen_fd =
+        socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, 0);
+    int const reuse = 1;
+    if (listen_fd < 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                   sizeof(reuse)) < 0 ||
+        bind(listen_fd, info->ai_addr, info->ai_addrlen) < 0 ||
+        listen(listen_fd, 8) < 0) {
+        std::cerr << "Unable to open metrics socket " << address << ": "
+                  << std::strerror(errno) << std::endl;
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+    freeaddrinfo(info);
+    if (listen_fd >= 0) {
+        thread = std::thread(&MetricsServer::serve, this);
+    }
+}
+
+/**
+ * Stop serving and close the socket.
+ */
+MetricsServer::~MetricsServer()
+{
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+}
+
+/**
+ * Accept and serve connections until the server is destroyed.
+ */
+void
+MetricsServer::serve()
+{
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        std::cerr << "Unable to lower the priority of the metrics server"
+                  << std::endl;
+    }
+    while (running) {
+        // Wake up regularly to notice when the server should stop.
+        pollfd fds = {listen_fd, POLLIN, 0};
+        if (poll(&fds, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            handleConnection(fd);
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Read a request from the given connection and send the response; the
+ * connection is closed after a single request.
+ */
+void
+MetricsServer::handleConnection(int fd)
+{
+    // A stalled client must not keep the server from stopping.
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < MAX_REQUEST_SIZE) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, n);
+    }
+
+    std::istringstream request_line(request.substr(0, request.find("\r\n")));
+    std::string method;
+    std::string target;
+    request_line >> method >> target;
+    std::string const path = target.substr(0, target.find('?'));
+    std::string status = "200 OK";
+    std::string body;
+    if (method != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (path != "/metrics" && path != "/") {
+        status = "404 Not Found";
+    } else {
+        body = metrics();
+    }
+
+    std::string const response =
+        "HTTP/1.0 " + status +
+        "\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " +
+        std::to_string(body.size()) +
+        "\r\n"
+        "Connection: close\r\n"
+        "\r\n" +
+        body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent,
+                         MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
+
+/**
+ * Return the current stats of all nodes in the text exposition format.
+ */
+std::string
+MetricsServer::metrics()
+{
+    std::map<std::string, Family> families;
+    for (Benchmark* node : nodes) {
+        PrometheusSink sink(&families, node->server_name);
+        node->sample_stats(sink, "");
+        sink.summary("/client_latency_ns", node->client_latency(),
+                     node->client_drops());
+    }
+    std::string out;
+    for (auto& elem : families) {
+        if (!elem.second.type.empty()) {
+            out += "# TYPE " + elem.first + " " + elem.second.type + "\n";
+        }
+        for (const std::string& sample : elem.second.samples) {
+            out += sample + "\n";
+        }
+    }
+    return out;
+}
+
+}  // namespace RooBench
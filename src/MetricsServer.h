@@ -0,0 +1,73 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_METRICSSERVER_H
+#define ROOBENCH_METRICSSERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+namespace RooBench {
+
+/**
+ * Serves the stats of the benchmark nodes running in this process over HTTP
+ * in the Prometheus text exposition format, so that the benchmarks can be
+ * scraped by the same tooling as production services.
+ *
+ * Every GET request is answered with the current values of the counters
+ * the nodes add to their stats samples (client, task and transport stats)
+ * and with a summary of each node's client latency in which dropped ops
+ * count as infinitely slow.  A metric is named after the JSON pointer of
+ * its value, e.g. "/transport/tx_data_pkts" becomes
+ * roobench_transport_tx_data_pkts; numeric pointer components become
+ * labels named after the preceding component, e.g. the count of task 3
+ * becomes roobench_task_count{task="3"}, and every sample is labeled with
+ * the name of its node.
+ *
+ * The server runs in its own thread with the SCHED_IDLE policy so that it
+ * only gets CPU time the benchmark threads leave unused.  It reads the
+ * stats the same way the stats dumps do, with atomic loads, and thus never
+ * blocks the benchmark threads.  Requests are served one at a time.
+ */
+class MetricsServer {
+  public:
+    MetricsServer(std::vector<Benchmark*> nodes, const std::string& address);
+    ~MetricsServer();
+
+  private:
+    void serve();
+    void handleConnection(int fd);
+    std::string metrics();
+
+    /// The benchmark nodes whose stats are served.
+    const std::vector<Benchmark*> nodes;
+
+    /// Listening TCP socket; -1 if the server could not be started.
+    int listen_fd;
+
+    /// False once the server thread should return.
+    std::atomic<bool> running;
+
+    /// Thread accepting and serving the requests.
+    std::thread thread;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_METRICSSERVER_H
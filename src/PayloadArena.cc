@@ -0,0 +1,153 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "PayloadArena.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "Counter.h"
+#include "WireFormat.h"
+
+namespace RooBench {
+
+namespace {
+
+/// Size of the hugepages requested for the arena.
+const size_t HUGEPAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Round the given size up to a multiple of the given power of two.
+ */
+size_t
+roundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Record the size of a request in the largest request size of its task
+ * type.
+ */
+void
+addRequest(std::unordered_map<int, size_t>* sizes,
+           const BenchConfig::Request& request)
+{
+    size_t const size = std::max<size_t>(
+        request.size, sizeof(WireFormat::Benchmark::Request));
+    size_t& largest = (*sizes)[request.taskId];
+    largest = std::max(largest, size);
+}
+
+}  // namespace
+
+/**
+ * Allocate and fill the payloads of all requests and responses of the given
+ * config.
+ *
+ * Throws std::bad_alloc if the arena cannot be mapped at all; a failure to
+ * get hugepages is reported on stderr and falls back to regular pages.
+ *
+ * @param config
+ *      Bench config whose requests and responses are sent from the arena.
+ * @param hugepages
+ *      True if the arena should be backed by hugepages.
+ */
+PayloadArena::PayloadArena(const BenchConfig& config, bool hugepages)
+    : base(MAP_FAILED)
+    , length(0)
+    , huge(false)
+    , requests()
+    , responses(nullptr)
+{
+    std::unordered_map<int, size_t> request_sizes;
+    size_t response_size = 1;
+    for (const BenchConfig::Client::Phase& phase : config.client.phases) {
+        for (const BenchConfig::Request& request : phase.requests) {
+            addRequest(&request_sizes, request);
+        }
+    }
+    for (auto& elem : config.tasks) {
+        for (const BenchConfig::Request& request : elem.second.requests) {
+            addRequest(&request_sizes, request);
+        }
+        for (const BenchConfig::Response& response : elem.second.responses) {
+            response_size = std::max<size_t>(response_size, response.size);
+        }
+    }
+
+    // Payloads start on separate cache lines.
+    size_t needed = roundUp(response_size, CACHE_LINE_SIZE);
+    for (auto& elem : request_sizes) {
+        needed += roundUp(elem.second, CACHE_LINE_SIZE);
+    }
+
+    if (hugepages) {
+        length = roundUp(needed, HUGEPAGE_SIZE);
+        base = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            std::cerr << "Unable to map the payload arena on hugepages: "
+                      << std::strerror(errno) << "; using regular pages"
+                      << std::endl;
+        } else {
+            huge = true;
+        }
+    }
+    if (base == MAP_FAILED) {
+        length = roundUp(needed, sysconf(_SC_PAGESIZE));
+        base = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+    }
+
+    // Touch every page now so that sending never faults them in, then stamp
+    // the request headers.
+    char* next = static_cast<char*>(base);
+    std::memset(next, 0, length);
+    responses = next;
+    next += roundUp(response_size, CACHE_LINE_SIZE);
+    for (auto& elem : request_sizes) {
+        WireFormat::Benchmark::Request header(elem.first);
+        std::memcpy(next, &header, sizeof(header));
+        requests.insert({elem.first, next});
+        next += roundUp(elem.second, CACHE_LINE_SIZE);
+    }
+
+    // Catch any attempt to write a payload shared by all threads.
+    if (mprotect(base, length, PROT_READ) != 0) {
+        std::cerr << "Unable to make the payload arena read-only: "
+                  << std::strerror(errno)
+                  << "; writes to the payloads will go unnoticed" << std::endl;
+    }
+}
+
+/**
+ * Unmap the arena.
+ */
+PayloadArena::~PayloadArena()
+{
+    munmap(base, length);
+}
+
+}  // namespace RooBench
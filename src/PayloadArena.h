@@ -0,0 +1,98 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_PAYLOADARENA_H
+#define ROOBENCH_PAYLOADARENA_H
+
+#include <cstddef>
+#include <unordered_map>
+
+#include "BenchConfig.h"
+
+namespace RooBench {
+
+/**
+ * Preallocated, read-only memory from which the benchmark sends the
+ * payloads of its requests and responses.
+ *
+ * The arena is sized from the largest request and response sizes of the
+ * bench config, filled once when it is created, and then shared by all
+ * benchmark threads, which only read it.  Every task type that requests are
+ * sent for has its own payload with the WireFormat request header already
+ * stamped, sized for the largest request of that type; all responses share
+ * a single payload sized for the largest response.  Sending a message thus
+ * never writes the payload; the transport copies it.
+ *
+ * The arena is backed by hugepages if requested and available, and by
+ * regular pages otherwise.  All methods are thread-safe.
+ */
+class PayloadArena {
+  public:
+    PayloadArena(const BenchConfig& config, bool hugepages);
+    ~PayloadArena();
+
+    PayloadArena(const PayloadArena&) = delete;
+    PayloadArena& operator=(const PayloadArena&) = delete;
+
+    /**
+     * Return the payload of the requests for the given task type; it holds
+     * at least as many bytes as the largest such request in the config.
+     */
+    const void* request(int task_id) const
+    {
+        return requests.at(task_id);
+    }
+
+    /**
+     * Return the payload shared by all responses; it holds at least as many
+     * bytes as the largest response in the config.
+     */
+    const void* response() const
+    {
+        return responses;
+    }
+
+    /// Returns true if the arena is backed by hugepages.
+    bool hugepages() const
+    {
+        return huge;
+    }
+
+    /// Returns the size in bytes of the mapping backing the arena.
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    /// Start of the mapping backing the arena.
+    void* base;
+
+    /// Size in bytes of the mapping.
+    size_t length;
+
+    /// True if the mapping uses hugepages.
+    bool huge;
+
+    /// Stamped request payload of each task type that requests are sent for.
+    std::unordered_map<int, const char*> requests;
+
+    /// Payload shared by all responses.
+    const char* responses;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_PAYLOADARENA_H
@@ -21,40 +21,34 @@
 #include <SimpleRpc/Debug.h>
 #include <SimpleRpc/Perf.h>
 
+#include <algorithm>
+#include <cmath>
 #include <deque>
-#include <fstream>
 #include <functional>
+#include <limits>
 #include <nlohmann/json.hpp>
 #include <random>
 
+#include "DriverFactory.h"
+#include "StatsWriter.h"
 #include "WireFormat.h"
 
 namespace RooBench {
 
 namespace {
-std::vector<Homa::Driver::Address>
-create_peer_list(const BenchConfig::ServerList& server_list,
-                 Homa::Driver* driver)
+/**
+ * Return true if the given driver's address is part of the server list.
+ */
+bool
+is_server(const BenchConfig::ServerList& server_list, Homa::Driver* driver)
 {
     Homa::Driver::Address localAddress = driver->getLocalAddress();
-    std::vector<Homa::Driver::Address> peer_list;
     for (auto& elem : server_list) {
-        Homa::Driver::Address serverAddress =
-            driver->getAddress(&elem.second.address);
-        if (serverAddress != localAddress) {
-            peer_list.push_back(serverAddress);
+        if (driver->getAddress(&elem.second.address) == localAddress) {
+            return true;
         }
     }
-    return peer_list;
-}
-
-Homa::Driver*
-startDriver()
-{
-    Homa::Drivers::DPDK::DpdkDriver::Config driverConfig;
-    driverConfig.HIGHEST_PACKET_PRIORITY_OVERRIDE = 0;
-    int port = 1;
-    return new Homa::Drivers::DPDK::DpdkDriver(port, &driverConfig);
+    return false;
 }
 
 }  // namespace
@@ -70,33 +64,46 @@ startDriver()
  *      Directory for log and stats output.
  * @param num_threads
  *      The number of threads that should be running run_benchmark().
+ * @param homa_driver
+ *      Driver through which this benchmark should communicate; ownership is
+ *      transferred to the benchmark.  If nullptr, a driver is created based
+ *      on the benchmark configuration.
  */
 RpcBenchmark::RpcBenchmark(nlohmann::json bench_config, std::string server_name,
-                           std::string output_dir, size_t num_threads)
+                           std::string output_dir, size_t num_threads,
+                           Homa::Driver* homa_driver)
     : Benchmark(bench_config, server_name, output_dir, num_threads)
-    , driver(startDriver())
+    , driver(homa_driver != nullptr
+                 ? homa_driver
+                 : DriverFactory::createDriver(config.driver))
     , transport(Homa::Transport::create(
           driver.get(), std::hash<std::string>{}(driver->addressToString(
                             driver->getLocalAddress()))))
     , socket(SimpleRpc::Socket::create(transport.get()))
     , peer_list(create_peer_list(config.serverList, driver.get()))
     , unified(config.unified)
-    , queueDepth(std::lround((config.load * 0.1) / config.client_count) + 1)
-    , cyclesPerOp(PerfUtils::Cycles::fromSeconds(
-          static_cast<double>(config.client_count) / config.load))
-    , nextOpTimeout(0)
+    , client_node(unified || !is_server(config.serverList, driver.get()))
+    , schedule(create_schedule(config))
+    , payloads(config, config.payload_hugepages)
+    , client_start_cycles(0)
     , run(true)
     , run_client(false)
-    , client_running()
-    , stats_mutex()
-    , client_stats()
-    , task_stats(create_task_stats_map(config.tasks))
-    , active_cycles(0)
+    , load_override(0)
+    , load_override_cycles(0)
+    , load_override_version(0)
+    , task_stats(create_task_stats_map(
+          config.tasks, thread_count(Role::CLIENT) +
+                            thread_count(Role::SERVER) +
+                            thread_count(Role::UNIFIED)))
+    , client_shards(create_client_shards(
+          thread_count(Role::CLIENT) + thread_count(Role::UNIFIED),
+          schedule.size(), config.client.phases.size(), peer_list.size()))
+    , thread_stats(thread_count(Role::CLIENT) + thread_count(Role::SERVER) +
+                   thread_count(Role::UNIFIED))
 {
     Homa::Debug::setLogPolicy(Homa::Debug::logPolicyFromString("ERROR"));
     SimpleRpc::Debug::setLogPolicy(
         SimpleRpc::Debug::logPolicyFromString("ERROR"));
-    client_running.clear();
 }
 
 /**
@@ -108,17 +115,66 @@ RpcBenchmark::~RpcBenchmark() = default;
  * @copydoc Benchmark::run_benchmark()
  */
 void
-RpcBenchmark::run_benchmark()
+RpcBenchmark::run_benchmark(const ThreadInfo& info)
 {
+    // Dedicated client threads leave polling the socket to the server threads
+    // unless there are none.
+    const bool client_polls = thread_count(Role::SERVER) == 0;
+
+    // Every thread doing client work runs its own generator which issues an
+    // equal share of the node's load (or of its closed-loop concurrency).
+    // Client and unified threads are numbered from 0 so the thread id is
+    // also the generator's index.
+    const uint64_t generator_count =
+        thread_count(Role::CLIENT) + thread_count(Role::UNIFIED);
+    std::unique_ptr<Generator> generator;
+    if (info.role != Role::SERVER) {
+        const int concurrency = config.closed_loop.concurrency;
+        int share = concurrency / generator_count;
+        if (info.id < concurrency % generator_count) {
+            share++;
+        }
+        generator.reset(new Generator(
+            generator_count, concurrency > 0, share,
+            PerfUtils::Cycles::fromSeconds(config.closed_loop.thinkTimeUs *
+                                           1e-6),
+            client_shards.at(info.id).get()));
+    }
+
+    ThreadStats& stats = thread_stats.at(info.id);
+    uint64_t iteration_start = PerfUtils::Cycles::rdtsc();
     while (run) {
-        if (run_client) {
-            socket->poll();
-            client_poll();
+        bool busy = false;
+        switch (info.role) {
+            case Role::CLIENT:
+                if (run_client) {
+                    if (client_polls) {
+                        poll_socket(&stats);
+                    }
+                    busy |= client_poll(generator.get(), info.id);
+                }
+                break;
+            case Role::SERVER:
+                poll_socket(&stats);
+                busy |= server_poll(info.id);
+                break;
+            case Role::UNIFIED:
+                if (run_client) {
+                    poll_socket(&stats);
+                    busy |= client_poll(generator.get(), info.id);
+                }
+                if (!run_client || unified) {
+                    poll_socket(&stats);
+                    busy |= server_poll(info.id);
+                }
+                break;
         }
-        if (!run_client || unified) {
-            socket->poll();
-            server_poll();
+        uint64_t const iteration_stop = PerfUtils::Cycles::rdtsc();
+        stats.total_cycles.add(iteration_stop - iteration_start);
+        if (!busy) {
+            stats.idle_poll_cycles.add(iteration_stop - iteration_start);
         }
+        iteration_start = iteration_stop;
     }
 }
 
@@ -126,109 +182,172 @@ RpcBenchmark::run_benchmark()
  * @copydoc Benchmark::dump_stats()
  */
 void
-RpcBenchmark::dump_stats()
+RpcBenchmark::dump_stats(const std::string& label)
 {
-    static int dump_count = 0;
-
     // Dump SimpleRpc Stats
     {
-        SimpleRpc::Perf::Stats stats;
-        SimpleRpc::Perf::getStats(&stats);
-        nlohmann::json rpc_stats;
-        rpc_stats["timestamp"] = stats.timestamp;
-        rpc_stats["cycles_per_second"] = stats.cycles_per_second;
-        rpc_stats["api_cycles"] = stats.api_cycles;
-        rpc_stats["active_cycles"] = stats.active_cycles;
-        rpc_stats["idle_cycles"] = stats.idle_cycles;
-        rpc_stats["tx_message_bytes"] = stats.tx_message_bytes;
-        rpc_stats["rx_message_bytes"] = stats.rx_message_bytes;
-        rpc_stats["transport_tx_bytes"] = stats.transport_tx_bytes;
-        rpc_stats["transport_rx_bytes"] = stats.transport_rx_bytes;
-        rpc_stats["tx_data_pkts"] = stats.tx_data_pkts;
-        rpc_stats["rx_data_pkts"] = stats.rx_data_pkts;
-        rpc_stats["tx_grant_pkts"] = stats.tx_grant_pkts;
-        rpc_stats["rx_grant_pkts"] = stats.rx_grant_pkts;
-        rpc_stats["tx_done_pkts"] = stats.tx_done_pkts;
-        rpc_stats["rx_done_pkts"] = stats.rx_done_pkts;
-        rpc_stats["tx_resend_pkts"] = stats.tx_resend_pkts;
-        rpc_stats["rx_resend_pkts"] = stats.rx_resend_pkts;
-        rpc_stats["tx_busy_pkts"] = stats.tx_busy_pkts;
-        rpc_stats["rx_busy_pkts"] = stats.rx_busy_pkts;
-        rpc_stats["tx_ping_pkts"] = stats.tx_ping_pkts;
-        rpc_stats["rx_ping_pkts"] = stats.rx_ping_pkts;
-        rpc_stats["tx_unknown_pkts"] = stats.tx_unknown_pkts;
-        rpc_stats["rx_unknown_pkts"] = stats.rx_unknown_pkts;
-        rpc_stats["tx_error_pkts"] = stats.tx_error_pkts;
-        rpc_stats["rx_error_pkts"] = stats.rx_error_pkts;
-
-        std::string rpc_stats_outfile_name =
-            output_dir + "/" + server_name + "_transport_stats_" +
-            std::to_string(dump_count) + ".json";
-        std::ofstream outfile(rpc_stats_outfile_name);
-        outfile << rpc_stats.dump();
+        StatsWriter rpc_stats(
+            output_dir + "/" + server_name + "_transport_stats_" + label,
+            config.stats_json);
+        write_transport_stats(rpc_stats, "");
     }
 
     // Dump Bench Stats
     {
-        uint64_t timestamp = PerfUtils::Cycles::rdtsc();
-        nlohmann::json bench_stats_json;
-        bench_stats_json["timestamp"] = timestamp;
-        bench_stats_json["cycles_per_second"] = PerfUtils::Cycles::perSecond();
+        StatsWriter out(
+            output_dir + "/" + server_name + "_bench_stats_" + label,
+            config.stats_json);
+        out.gauge("/timestamp", stats_timestamp());
+        out.number("/cycles_per_second", PerfUtils::Cycles::perSecond());
+
+        uint64_t client_cycles =
+            thread_total(&ThreadStats::client_active_cycles);
+        uint64_t server_cycles =
+            thread_total(&ThreadStats::server_active_cycles);
+        out.counter("/active_cycles", client_cycles + server_cycles);
+        out.counter("/client_active_cycles", client_cycles);
+        out.counter("/server_active_cycles", server_cycles);
+        out.gauge("/client_threads",
+                  thread_count(Role::CLIENT) + thread_count(Role::UNIFIED));
+        out.gauge("/server_threads",
+                  thread_count(Role::SERVER) + thread_count(Role::UNIFIED));
+        out.json("/placement", thread_placement());
 
-        bench_stats_json["active_cycles"] = active_cycles.load();
+        // Thread stats
+        for (size_t i = 0; i < thread_stats.size(); ++i) {
+            const ThreadStats& stats = thread_stats.at(i);
+            std::string const prefix = "/thread_stats/" + std::to_string(i);
+            out.gauge(prefix + "/thread", i);
+            out.counter(prefix + "/total_cycles", stats.total_cycles.load());
+            out.counter(prefix + "/client_active_cycles",
+                        stats.client_active_cycles.load());
+            out.counter(prefix + "/server_active_cycles",
+                        stats.server_active_cycles.load());
+            out.counter(prefix + "/idle_poll_cycles",
+                        stats.idle_poll_cycles.load());
+            out.counter(prefix + "/polls", stats.polls.load());
+            out.string(prefix + "/unit", "ns");
+            out.histogram(prefix + "/poll_gap", stats.poll_gap);
+        }
 
         // Task stats
-        std::vector<nlohmann::json> task_stats_json_list;
+        size_t task_index = 0;
         for (auto& elem : task_stats) {
-            nlohmann::json task_stats_json;
-            task_stats_json["id"] = elem.first;
-            task_stats_json["count"] = elem.second->count.load();
-            task_stats_json_list.push_back(task_stats_json);
+            std::string const prefix =
+                "/task_stats/" + std::to_string(task_index++);
+            out.gauge(prefix + "/id", elem.first);
+            out.counter(prefix + "/count", task_total(*elem.second));
+            Histogram queueing;
+            Histogram service;
+            Histogram request_bytes;
+            Histogram response_bytes;
+            for (const TaskShard& shard : elem.second->shards) {
+                queueing.merge(shard.queueing);
+                service.merge(shard.service);
+                request_bytes.merge(shard.request_bytes);
+                response_bytes.merge(shard.response_bytes);
+            }
+            out.string(prefix + "/unit", "ns");
+            out.histogram(prefix + "/queueing", queueing);
+            out.histogram(prefix + "/service", service);
+            out.histogram(prefix + "/request_bytes", request_bytes);
+            out.histogram(prefix + "/response_bytes", response_bytes);
         }
 
         // Client stats
-        nlohmann::json client_stats_json;
-        client_stats_json["count"] = client_stats.count.load();
-        client_stats_json["failures"] = client_stats.failures.load();
-        client_stats_json["drops"] = client_stats.drops.load();
-        uint64_t const sample_count =
-            std::min(static_cast<uint64_t>(client_stats_json["count"]),
-                     client_stats.samples.max_size());
-        std::vector<uint> latencies;
-        for (uint64_t i = 0; i < sample_count; ++i) {
-            latencies.push_back(
-                PerfUtils::Cycles::toNanoseconds(client_stats.samples.at(i)));
+        out.counter("/client_stats/count",
+                    client_total(&ClientCounters::count));
+        out.counter("/client_stats/failures",
+                    client_total(&ClientCounters::failures));
+        out.counter("/client_stats/drops",
+                    client_total(&ClientCounters::drops));
+        out.counter("/client_stats/offered",
+                    client_total(&ClientCounters::offered));
+        out.counter("/client_stats/delayed",
+                    client_total(&ClientCounters::delayed));
+        out.counter("/client_stats/lag_cycles",
+                    client_total(&ClientCounters::lag_cycles));
+        std::vector<Histogram> step_latency(schedule.size());
+        Histogram latency;
+        for (auto& shard : client_shards) {
+            for (size_t i = 0; i < schedule.size(); ++i) {
+                step_latency.at(i).merge(shard->steps.at(i));
+            }
+        }
+        for (const Histogram& histogram : step_latency) {
+            latency.merge(histogram);
         }
-        client_stats_json["unit"] = "ns";
-        client_stats_json["latencies"] = nlohmann::json(latencies);
+        out.string("/client_stats/unit", "ns");
+        out.histogram("/client_stats/latency", latency);
 
-        bench_stats_json["task_stats"] = nlohmann::json(task_stats_json_list);
-        bench_stats_json["client_stats"] = client_stats_json;
+        // Phase stats
+        for (size_t i = 0; i < config.client.phases.size(); ++i) {
+            Histogram phase_latency;
+            for (auto& shard : client_shards) {
+                phase_latency.merge(shard->phases.at(i));
+            }
+            std::string const prefix =
+                "/client_stats/phases/" + std::to_string(i);
+            out.gauge(prefix + "/index", i);
+            out.histogram(prefix + "/latency", phase_latency);
+        }
 
-        // Dump stats
-        std::string bench_stats_outfile_name =
-            output_dir + "/" + server_name + "_bench_stats_" +
-            std::to_string(dump_count) + ".json";
-        std::ofstream outfile(bench_stats_outfile_name);
-        outfile << bench_stats_json.dump();
+        // Load step stats
+        for (size_t i = 0; i < schedule.size(); ++i) {
+            const BenchConfig::LoadStep& step_config =
+                config.load_schedule.at(i);
+            std::string const prefix =
+                "/client_stats/steps/" + std::to_string(i);
+            out.gauge(prefix + "/index", i);
+            out.number(prefix + "/load", step_config.load);
+            out.number(prefix + "/duration", step_config.duration);
+            out.counter(prefix + "/count", step_total(i, &StepCounters::count));
+            out.counter(prefix + "/failures",
+                        step_total(i, &StepCounters::failures));
+            out.counter(prefix + "/drops", step_total(i, &StepCounters::drops));
+            out.counter(prefix + "/offered",
+                        step_total(i, &StepCounters::offered));
+            out.histogram(prefix + "/latency", step_latency.at(i));
+        }
+
+        // Peer stats
+        for (size_t i = 0; i < peer_list.size(); ++i) {
+            Histogram peer_latency;
+            for (auto& shard : client_shards) {
+                peer_latency.merge(shard->peers.at(i));
+            }
+            std::string const prefix =
+                "/client_stats/peers/" + std::to_string(i);
+            out.string(prefix + "/name", peer_list.at(i).name);
+            out.string(prefix + "/address",
+                       driver->addressToString(peer_list.at(i).address));
+            out.counter(prefix + "/sent", peer_total(i, &PeerCounters::sent));
+            out.counter(prefix + "/completed",
+                        peer_total(i, &PeerCounters::completed));
+            out.counter(prefix + "/failures",
+                        peer_total(i, &PeerCounters::failures));
+            out.histogram(prefix + "/latency", peer_latency);
+        }
     }
 
     // Dump time trace
     std::string ttlogname = output_dir + "/" + server_name + "_tt_" +
-                            std::to_string(dump_count) + ".log";
+                            label + ".log";
     PerfUtils::TimeTrace::setOutputFileName(ttlogname.c_str());
     PerfUtils::TimeTrace::print();
-
-    dump_count++;
 }
 
 /**
  * @copydoc Benchmark::start_client()
  */
 void
-RpcBenchmark::start_client()
+RpcBenchmark::start_client(uint64_t start_cycles)
 {
-    nextOpTimeout = PerfUtils::Cycles::rdtsc();
+    // Only client nodes run a client; a server node just starts its run.
+    if (!client_node) {
+        return;
+    }
+    client_start_cycles = start_cycles;
     run_client = true;
 }
 
@@ -241,69 +360,461 @@ RpcBenchmark::stop()
     run = false;
 }
 
+/**
+ * @copydoc Benchmark::set_load()
+ *
+ * The new load replaces the load schedule for the rest of the run; ops keep
+ * being tagged with the step that was in effect when the load was set.
+ */
+bool
+RpcBenchmark::set_load(double load)
+{
+    // The closed-loop mode does not follow an offered load.
+    if (config.closed_loop.concurrency > 0) {
+        return false;
+    }
+    uint64_t cycles_per_op = 0;
+    if (load > 0) {
+        cycles_per_op = PerfUtils::Cycles::fromSeconds(
+            static_cast<double>(config.client_count) / load);
+    }
+    load_override = load;
+    load_override_cycles = cycles_per_op;
+    load_override_version++;
+    return true;
+}
+
+/**
+ * @copydoc Benchmark::status()
+ */
+nlohmann::json
+RpcBenchmark::status()
+{
+    nlohmann::json status;
+    status["client"] = client_node;
+    status["client_running"] = run_client.load();
+    status["count"] = client_total(&ClientCounters::count);
+    status["failures"] = client_total(&ClientCounters::failures);
+    status["drops"] = client_total(&ClientCounters::drops);
+    status["offered"] = client_total(&ClientCounters::offered);
+    if (load_override_version > 0) {
+        status["load"] = load_override.load();
+    }
+    return status;
+}
+
+/**
+ * @copydoc Benchmark::client_latency()
+ */
+Histogram
+RpcBenchmark::client_latency()
+{
+    Histogram latency;
+    for (auto& shard : client_shards) {
+        for (const Histogram& histogram : shard->steps) {
+            latency.merge(histogram);
+        }
+    }
+    return latency;
+}
+
+/**
+ * @copydoc Benchmark::client_drops()
+ */
+uint64_t
+RpcBenchmark::client_drops()
+{
+    return client_total(&ClientCounters::drops);
+}
+
+/**
+ * @copydoc Benchmark::sample_stats()
+ */
+void
+RpcBenchmark::sample_stats(StatsSink& out, const std::string& prefix)
+{
+    write_transport_stats(out, prefix + "/transport");
+
+    uint64_t client_cycles = thread_total(&ThreadStats::client_active_cycles);
+    uint64_t server_cycles = thread_total(&ThreadStats::server_active_cycles);
+    out.counter(prefix + "/active_cycles", client_cycles + server_cycles);
+    out.counter(prefix + "/client_active_cycles", client_cycles);
+    out.counter(prefix + "/server_active_cycles", server_cycles);
+
+    for (size_t i = 0; i < thread_stats.size(); ++i) {
+        const ThreadStats& stats = thread_stats.at(i);
+        std::string const thread_prefix =
+            prefix + "/thread_stats/" + std::to_string(i);
+        out.counter(thread_prefix + "/total_cycles", stats.total_cycles.load());
+        out.counter(thread_prefix + "/client_active_cycles",
+                    stats.client_active_cycles.load());
+        out.counter(thread_prefix + "/server_active_cycles",
+                    stats.server_active_cycles.load());
+        out.counter(thread_prefix + "/idle_poll_cycles",
+                    stats.idle_poll_cycles.load());
+        out.counter(thread_prefix + "/polls", stats.polls.load());
+    }
+
+    out.counter(prefix + "/client_stats/count",
+                client_total(&ClientCounters::count));
+    out.counter(prefix + "/client_stats/failures",
+                client_total(&ClientCounters::failures));
+    out.counter(prefix + "/client_stats/drops",
+                client_total(&ClientCounters::drops));
+    out.counter(prefix + "/client_stats/offered",
+                client_total(&ClientCounters::offered));
+
+    // Keyed by the task id, unlike the dumps, so that the Prometheus label
+    // of each count is the id of its task.
+    for (auto& elem : task_stats) {
+        out.counter(prefix + "/task/" + std::to_string(elem.first) + "/count",
+                    task_total(*elem.second));
+    }
+}
+
+/**
+ * @copydoc Benchmark::in_window_outstanding()
+ */
+uint64_t
+RpcBenchmark::in_window_outstanding()
+{
+    // Every op offered in the window ends up completed, failed or dropped.
+    // The outcomes are read first so that ops offered meanwhile are counted
+    // as outstanding rather than the other way around.
+    uint64_t const done = client_total(&ClientCounters::count) +
+                          client_total(&ClientCounters::failures) +
+                          client_total(&ClientCounters::drops);
+    uint64_t const offered = client_total(&ClientCounters::offered);
+    return offered > done ? offered - done : 0;
+}
+
+/**
+ * Write the SimpleRpc stats, which are shared by all benchmark instances of the
+ * process.
+ *
+ * @param out
+ *      Writer to which the stats are added.
+ * @param prefix
+ *      JSON pointer under which the stats belong; empty for the top level.
+ */
+void
+RpcBenchmark::write_transport_stats(StatsSink& out, const std::string& prefix)
+{
+    SimpleRpc::Perf::Stats stats;
+    SimpleRpc::Perf::getStats(&stats);
+    out.gauge(prefix + "/timestamp", stats.timestamp);
+    out.number(prefix + "/cycles_per_second", stats.cycles_per_second);
+    out.counter(prefix + "/api_cycles", stats.api_cycles);
+    out.counter(prefix + "/active_cycles", stats.active_cycles);
+    out.counter(prefix + "/idle_cycles", stats.idle_cycles);
+    out.counter(prefix + "/tx_message_bytes", stats.tx_message_bytes);
+    out.counter(prefix + "/rx_message_bytes", stats.rx_message_bytes);
+    out.counter(prefix + "/transport_tx_bytes", stats.transport_tx_bytes);
+    out.counter(prefix + "/transport_rx_bytes", stats.transport_rx_bytes);
+    out.counter(prefix + "/tx_data_pkts", stats.tx_data_pkts);
+    out.counter(prefix + "/rx_data_pkts", stats.rx_data_pkts);
+    out.counter(prefix + "/tx_grant_pkts", stats.tx_grant_pkts);
+    out.counter(prefix + "/rx_grant_pkts", stats.rx_grant_pkts);
+    out.counter(prefix + "/tx_done_pkts", stats.tx_done_pkts);
+    out.counter(prefix + "/rx_done_pkts", stats.rx_done_pkts);
+    out.counter(prefix + "/tx_resend_pkts", stats.tx_resend_pkts);
+    out.counter(prefix + "/rx_resend_pkts", stats.rx_resend_pkts);
+    out.counter(prefix + "/tx_busy_pkts", stats.tx_busy_pkts);
+    out.counter(prefix + "/rx_busy_pkts", stats.rx_busy_pkts);
+    out.counter(prefix + "/tx_ping_pkts", stats.tx_ping_pkts);
+    out.counter(prefix + "/rx_ping_pkts", stats.rx_ping_pkts);
+    out.counter(prefix + "/tx_unknown_pkts", stats.tx_unknown_pkts);
+    out.counter(prefix + "/rx_unknown_pkts", stats.rx_unknown_pkts);
+    out.counter(prefix + "/tx_error_pkts", stats.tx_error_pkts);
+    out.counter(prefix + "/rx_error_pkts", stats.rx_error_pkts);
+}
+
+/**
+ * Helper static method to resolve the servers other than this node.
+ */
+std::vector<RpcBenchmark::Peer>
+RpcBenchmark::create_peer_list(const BenchConfig::ServerList& server_list,
+                               Homa::Driver* driver)
+{
+    Homa::Driver::Address localAddress = driver->getLocalAddress();
+    std::vector<Peer> peer_list;
+    for (auto& elem : server_list) {
+        Homa::Driver::Address serverAddress =
+            driver->getAddress(&elem.second.address);
+        if (serverAddress != localAddress) {
+            peer_list.push_back({serverAddress, elem.second.name});
+        }
+    }
+    return peer_list;
+}
+
 /**
  * Helper static method to initialize the task_stats map.
  */
 std::unordered_map<int, const std::unique_ptr<RpcBenchmark::TaskStats>>
-RpcBenchmark::create_task_stats_map(const BenchConfig::TaskMap& task_map)
+RpcBenchmark::create_task_stats_map(const BenchConfig::TaskMap& task_map,
+                                    std::size_t shard_count)
 {
     std::unordered_map<int, const std::unique_ptr<TaskStats>> task_stats;
     for (auto& elem : task_map) {
-        task_stats.emplace(elem.first, new TaskStats());
-        task_stats.at(elem.first)->count.store(0);
+        task_stats.emplace(elem.first, new TaskStats(shard_count));
     }
     return task_stats;
 }
 
 /**
- * Perform increment work to process incoming ServerTasks
+ * Helper static method to convert the configured load schedule into cycles.
+ */
+std::vector<RpcBenchmark::LoadStep>
+RpcBenchmark::create_schedule(const BenchConfig& config)
+{
+    std::vector<LoadStep> schedule;
+    double stop_time = 0.0;
+    for (const BenchConfig::LoadStep& step_config : config.load_schedule) {
+        LoadStep step;
+        stop_time += step_config.duration;
+        step.stopCycles = PerfUtils::Cycles::fromSeconds(stop_time);
+        step.cyclesPerOp = 0;
+        if (step_config.load > 0) {
+            step.cyclesPerOp = PerfUtils::Cycles::fromSeconds(
+                static_cast<double>(config.client_count) / step_config.load);
+        }
+        schedule.push_back(step);
+    }
+    return schedule;
+}
+
+/**
+ * Helper static method to initialize the stats of the generators.
+ */
+std::vector<std::unique_ptr<ClientShard>>
+RpcBenchmark::create_client_shards(std::size_t shard_count,
+                                   std::size_t step_count,
+                                   std::size_t phase_count,
+                                   std::size_t peer_count)
+{
+    std::vector<std::unique_ptr<ClientShard>> client_shards;
+    for (std::size_t i = 0; i < shard_count; ++i) {
+        client_shards.emplace_back(
+            new ClientShard(step_count, phase_count, peer_count));
+    }
+    return client_shards;
+}
+
+/**
+ * Return the number of requests of the given task handled so far.
+ */
+uint64_t
+RpcBenchmark::task_total(const TaskStats& stats)
+{
+    uint64_t total = 0;
+    for (const TaskShard& shard : stats.shards) {
+        total += shard.count.load();
+    }
+    return total;
+}
+
+/**
+ * Return the sum of the given client counter over all generators.
+ */
+uint64_t
+RpcBenchmark::client_total(Counter ClientCounters::*counter) const
+{
+    uint64_t total = 0;
+    for (auto& shard : client_shards) {
+        total += (shard->counters.*counter).load();
+    }
+    return total;
+}
+
+/**
+ * Return the sum of the given counter of a load step over all generators.
+ */
+uint64_t
+RpcBenchmark::step_total(size_t step, Counter StepCounters::*counter) const
+{
+    uint64_t total = 0;
+    for (auto& shard : client_shards) {
+        total += (shard->step_counters.at(step).*counter).load();
+    }
+    return total;
+}
+
+/**
+ * Return the sum of the given counter of a peer over all generators.
+ */
+uint64_t
+RpcBenchmark::peer_total(size_t peer, Counter PeerCounters::*counter) const
+{
+    uint64_t total = 0;
+    for (auto& shard : client_shards) {
+        total += (shard->peer_counters.at(peer).*counter).load();
+    }
+    return total;
+}
+
+/**
+ * Return the sum of the given counter over all benchmark threads.
+ */
+uint64_t
+RpcBenchmark::thread_total(Counter ThreadStats::*counter) const
+{
+    uint64_t total = 0;
+    for (const ThreadStats& stats : thread_stats) {
+        total += (stats.*counter).load();
+    }
+    return total;
+}
+
+/**
+ * Poll the socket on behalf of a benchmark thread and record the time since
+ * the thread's previous poll.
+ *
+ * @param stats
+ *      CPU accounting of the calling benchmark thread.
  */
 void
-RpcBenchmark::server_poll()
+RpcBenchmark::poll_socket(ThreadStats* stats)
+{
+    uint64_t const now = PerfUtils::Cycles::rdtsc();
+    if (stats->last_poll_cycles != 0) {
+        stats->poll_gap.record(
+            PerfUtils::Cycles::toNanoseconds(now - stats->last_poll_cycles));
+    }
+    stats->last_poll_cycles = now;
+    ++stats->polls;
+    socket->poll();
+}
+
+/**
+ * Perform increment work to process incoming ServerTasks
+ *
+ * @param thread
+ *      Id of the calling benchmark thread; selects the histograms in which
+ *      the handled tasks are recorded.
+ * @return
+ *      True if a task was handled; false if there was no work to do.
+ */
+bool
+RpcBenchmark::server_poll(size_t thread)
 {
     uint64_t const start_tsc = PerfUtils::Cycles::rdtsc();
     SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task = socket->receive();
-    if (task) {
-        dispatch(std::move(task));
-        uint64_t const stop_tsc = PerfUtils::Cycles::rdtsc();
-        active_cycles.fetch_add(stop_tsc - start_tsc,
-                                std::memory_order_relaxed);
+    if (!task) {
+        return false;
     }
+    dispatch(std::move(task), thread);
+    uint64_t const stop_tsc = PerfUtils::Cycles::rdtsc();
+    thread_stats.at(thread).server_active_cycles.add(stop_tsc - start_tsc);
+    return true;
 }
 
 /**
  * Perform incremental work to process outgoing client SimpleRpc
+ *
+ * @param generator
+ *      Load generator of the calling benchmark thread.
+ * @param thread
+ *      Id of the calling benchmark thread.
+ * @return
+ *      True if the poll issued or completed ops; false if there was no work
+ *      to do.
  */
-void
-RpcBenchmark::client_poll()
+bool
+RpcBenchmark::client_poll(Generator* generator, size_t thread)
 {
     bool idle = true;
     uint64_t const start_tsc = PerfUtils::Cycles::rdtsc();
-    static thread_local std::random_device rd;
-    static thread_local std::mt19937 gen(rd());
-    static thread_local std::poisson_distribution<uint64_t> dis(cyclesPerOp);
-    static thread_local std::deque<Op*> ops;
+    std::deque<Op*>& ops = generator->ops;
+    ClientShard* const stats = generator->stats;
 
-    if (client_running.test_and_set()) {
-        return;
+    uint64_t const now = PerfUtils::Cycles::rdtsc();
+
+    // A synchronized start may be scheduled in the future.
+    if (now < client_start_cycles) {
+        return false;
     }
 
-    // Check if it is time for another execution
-    uint64_t timeout = nextOpTimeout.load();
-    if (timeout <= PerfUtils::Cycles::rdtsc() &&
-        nextOpTimeout.compare_exchange_strong(timeout, timeout + dis(gen))) {
-        if (ops.size() < 10) {
+    // Start at the first step of the load schedule and follow the schedule
+    // as time passes; the last step lasts until the benchmark stops.
+    if (!generator->started) {
+        generator->started = true;
+        generator->slotTimeouts.assign(generator->concurrency,
+                                       client_start_cycles);
+        start_step(generator, 0, client_start_cycles);
+    }
+    uint64_t const load_version = load_override_version.load();
+    if (load_version != generator->loadVersion) {
+        // The load set through set_load() replaces the schedule.
+        generator->loadVersion = load_version;
+        set_rate(generator, load_override_cycles.load(), now);
+    }
+    while (generator->loadVersion == 0 &&
+           generator->step + 1 < schedule.size() &&
+           now - client_start_cycles >= schedule[generator->step].stopCycles) {
+        start_step(generator, generator->step + 1,
+                   client_start_cycles + schedule[generator->step].stopCycles);
+    }
+
+    // Check if it is time for another execution.  Ops start at the time
+    // they were due rather than when this poll notices them so that their
+    // latency includes any delay before they are issued; otherwise a lagging
+    // generator or a full queue would hide exactly the slow ops
+    // (coordinated omission).
+    if (generator->closedLoop) {
+        // Closed loop: an idle slot issues its next op once its think time
+        // has passed.
+        while (!generator->slotTimeouts.empty() &&
+               generator->slotTimeouts.front() <= now) {
+            uint64_t const timeout = generator->slotTimeouts.front();
+            generator->slotTimeouts.pop_front();
+            if (in_window(timeout)) {
+                ++stats->counters.offered;
+                ++stats->step_counters[generator->step].offered;
+                stats->counters.lag_cycles.add(now - timeout);
+            }
             Op* op = new Op;
+            op->step = generator->step;
             op->start_cycles = timeout;
             ops.push_back(op);
-        } else {
-            client_stats.drops++;
+        }
+    } else {
+        // Open loop: every arrival that is due joins the backlog; arrivals
+        // beyond what the backlog holds are dropped.
+        while (generator->nextOpTimeout <= now) {
+            uint64_t const timeout = generator->nextOpTimeout;
+            generator->nextOpTimeout += generator->dis(generator->gen);
+            if (in_window(timeout)) {
+                ++stats->counters.offered;
+                ++stats->step_counters[generator->step].offered;
+            }
+            if (generator->backlog.size() < generator->queueDepth) {
+                if (in_window(timeout) &&
+                    ops.size() + generator->backlog.size() >=
+                        generator->queueDepth) {
+                    ++stats->counters.delayed;
+                }
+                Op* op = new Op;
+                op->step = generator->step;
+                op->start_cycles = timeout;
+                generator->backlog.push_back(op);
+            } else if (in_window(timeout)) {
+                ++stats->counters.drops;
+                ++stats->step_counters[generator->step].drops;
+            }
+        }
+        // Issue the backlog as far as the limit on ops in flight allows.
+        while (!generator->backlog.empty() &&
+               ops.size() < generator->queueDepth) {
+            Op* op = generator->backlog.front();
+            generator->backlog.pop_front();
+            if (in_window(op->start_cycles)) {
+                stats->counters.lag_cycles.add(now - op->start_cycles);
+            }
+            ops.push_back(op);
         }
     }
 
-    const int buf_size = 1000000;
-    char buf[buf_size];
-
     if (!ops.empty()) {
         Op* op = ops.front();
         ops.pop_front();
@@ -321,11 +832,23 @@ RpcBenchmark::client_poll()
                 if (status == SimpleRpc::Rpc::Status::IN_PROGRESS) {
                     ++it;
                 } else if (status == SimpleRpc::Rpc::Status::FAILED) {
+                    if (in_window(op->start_cycles)) {
+                        ++stats->peer_counters[it->peer].failures;
+                    }
                     op->failed = true;
                     op->tasks.clear();
                     break;
                 } else {
                     idle = false;
+                    // Follow-up Rpcs are sent as the completion is seen.
+                    uint64_t const complete_cycles =
+                        PerfUtils::Cycles::rdtsc();
+                    if (in_window(op->start_cycles)) {
+                        ++stats->peer_counters[it->peer].completed;
+                        stats->peers[it->peer].record(
+                            PerfUtils::Cycles::toNanoseconds(
+                                complete_cycles - it->send_cycles));
+                    }
                     const BenchConfig::Task& task_config =
                         config.tasks.at(it->id);
                     for (const BenchConfig::Request& request_config :
@@ -333,18 +856,17 @@ RpcBenchmark::client_poll()
                         for (int i = 0; i < request_config.count; ++i) {
                             SimpleRpc::unique_ptr<SimpleRpc::Rpc> rpc =
                                 socket->allocRpc();
-                            WireFormat::Benchmark::Request* request =
-                                reinterpret_cast<
-                                    WireFormat::Benchmark::Request*>(buf);
-                            request->common.opcode =
-                                WireFormat::Benchmark::opcode;
-                            request->taskType = request_config.taskId;
-                            Homa::Driver::Address dest = selectServer();
+                            size_t const peer = selectServer();
                             assert(request_config.size >=
                                    sizeof(WireFormat::Benchmark::Request));
-                            assert(request_config.size <= sizeof(buf));
-                            rpc->send(dest, buf, request_config.size);
-                            op->tasks.emplace_back(request_config.taskId,
+                            rpc->send(peer_list[peer].address,
+                                      payloads.request(request_config.taskId),
+                                      request_config.size);
+                            if (in_window(op->start_cycles)) {
+                                ++stats->peer_counters[peer].sent;
+                            }
+                            op->tasks.emplace_back(request_config.taskId, peer,
+                                                   complete_cycles,
                                                    std::move(rpc));
                         }
                     }
@@ -355,21 +877,23 @@ RpcBenchmark::client_poll()
             op->tasks.clear();
         } else if (op->nextPhase != config.client.phases.cend()) {
             idle = false;
+            op->phase_cycles.push_back(PerfUtils::Cycles::rdtsc());
             const BenchConfig::Client::Phase& phase = *op->nextPhase;
             for (const BenchConfig::Request& request_config : phase.requests) {
                 for (int i = 0; i < request_config.count; ++i) {
                     SimpleRpc::unique_ptr<SimpleRpc::Rpc> rpc =
                         socket->allocRpc();
-                    WireFormat::Benchmark::Request* request =
-                        reinterpret_cast<WireFormat::Benchmark::Request*>(buf);
-                    request->common.opcode = WireFormat::Benchmark::opcode;
-                    request->taskType = request_config.taskId;
-                    Homa::Driver::Address dest = selectServer();
+                    size_t const peer = selectServer();
                     assert(request_config.size >=
                            sizeof(WireFormat::Benchmark::Request));
-                    assert(request_config.size <= sizeof(buf));
-                    rpc->send(dest, buf, request_config.size);
-                    op->tasks.emplace_back(request_config.taskId,
+                    rpc->send(peer_list[peer].address,
+                              payloads.request(request_config.taskId),
+                              request_config.size);
+                    if (in_window(op->start_cycles)) {
+                        ++stats->peer_counters[peer].sent;
+                    }
+                    op->tasks.emplace_back(request_config.taskId, peer,
+                                           op->phase_cycles.back(),
                                            std::move(rpc));
                 }
             }
@@ -378,51 +902,143 @@ RpcBenchmark::client_poll()
         if (op->nextPhase == config.client.phases.cend() && op->tasks.empty()) {
             op->stop_cycles = PerfUtils::Cycles::rdtsc();
             idle = false;
-            if (!op->failed) {
-                // Update stats
-                std::lock_guard<std::mutex> lock(stats_mutex);
-                uint64_t sample = op->stop_cycles - op->start_cycles;
-                client_stats.samples.at(client_stats.sample_count &
-                                        SAMPLE_INDEX_MASK) = sample;
-                client_stats.sample_count++;
-                client_stats.count++;
+            if (!in_window(op->start_cycles)) {
+                // Ops started outside of the measurement window don't count
+            } else if (!op->failed) {
+                // Update stats; a phase lasts until the next phase is sent.
+                stats->steps[op->step].record(
+                    PerfUtils::Cycles::toNanoseconds(op->stop_cycles -
+                                                     op->start_cycles));
+                for (size_t i = 0; i < op->phase_cycles.size(); ++i) {
+                    uint64_t const phase_stop =
+                        i + 1 < op->phase_cycles.size()
+                            ? op->phase_cycles[i + 1]
+                            : op->stop_cycles;
+                    stats->phases[i].record(PerfUtils::Cycles::toNanoseconds(
+                        phase_stop - op->phase_cycles[i]));
+                }
+                ++stats->counters.count;
+                ++stats->step_counters[op->step].count;
             } else {
-                client_stats.failures++;
+                ++stats->counters.failures;
+                ++stats->step_counters[op->step].failures;
+            }
+            if (generator->closedLoop) {
+                generator->slotTimeouts.push_back(op->stop_cycles +
+                                                  generator->thinkCycles);
             }
             delete op;
         } else {
             ops.push_back(op);
         }
     }
-    client_running.clear();
+    if (idle) {
+        return false;
+    }
     uint64_t const stop_tsc = PerfUtils::Cycles::rdtsc();
-    if (!idle) {
-        active_cycles.fetch_add(stop_tsc - start_tsc,
-                                std::memory_order_relaxed);
+    thread_stats.at(thread).client_active_cycles.add(stop_tsc - start_tsc);
+    return true;
+}
+
+/**
+ * Switch a generator to a step of the load schedule.
+ *
+ * @param generator
+ *      Generator that should switch steps.
+ * @param step
+ *      Index of the step in the load schedule.
+ * @param start_cycles
+ *      Time at which the step starts.
+ */
+void
+RpcBenchmark::start_step(Generator* generator, size_t step,
+                         uint64_t start_cycles)
+{
+    generator->step = step;
+    set_rate(generator, schedule.at(step).cyclesPerOp, start_cycles);
+}
+
+/**
+ * Change the rate at which a generator issues ops.
+ *
+ * @param generator
+ *      Generator whose rate should change.
+ * @param cycles_per_op
+ *      Mean cycles between two ops issued by this node; 0 if the node should
+ *      not issue any ops.
+ * @param start_cycles
+ *      Time from which the new rate applies.
+ */
+void
+RpcBenchmark::set_rate(Generator* generator, uint64_t cycles_per_op,
+                       uint64_t start_cycles)
+{
+    cycles_per_op *= generator->generators;
+    generator->queueDepth = queue_depth(generator->generators, cycles_per_op);
+    if (cycles_per_op > 0) {
+        generator->dis.param(
+            std::poisson_distribution<uint64_t>::param_type(cycles_per_op));
+        // Offset the first op by a random inter-arrival time so that the
+        // generators do not issue their ops in lockstep.
+        generator->nextOpTimeout =
+            start_cycles + generator->dis(generator->gen);
+    } else {
+        generator->nextOpTimeout = std::numeric_limits<uint64_t>::max();
     }
 }
 
-Homa::Driver::Address
+/**
+ * Return the number of open-loop ops a generator may keep in flight.
+ *
+ * A fixed limit is split evenly among the generators.  Otherwise, the limit
+ * is the number of ops the generator is expected to have in flight at its
+ * rate (Little's law), scaled by the configured headroom, plus one.
+ *
+ * @param generators
+ *      Number of generators that share the node's load.
+ * @param cycles_per_op
+ *      Mean cycles between two ops issued by the generator; 0 if the
+ *      generator does not issue any ops.
+ */
+std::size_t
+RpcBenchmark::queue_depth(uint64_t generators, uint64_t cycles_per_op) const
+{
+    const BenchConfig::Outstanding& outstanding = config.outstanding;
+    if (outstanding.limit > 0) {
+        return std::max<uint64_t>(
+            1, (outstanding.limit + generators - 1) / generators);
+    }
+    if (cycles_per_op == 0) {
+        return 1;
+    }
+    double const latency_cycles = PerfUtils::Cycles::fromSeconds(
+        outstanding.expectedLatencyUs * 1e-6);
+    double const ops_in_flight = latency_cycles / cycles_per_op;
+    return std::lround(outstanding.headroom * ops_in_flight) + 1;
+}
+
+/**
+ * Return the index in peer_list of a randomly selected server.
+ */
+size_t
 RpcBenchmark::selectServer()
 {
     static thread_local std::random_device rd;
     static thread_local std::mt19937 gen(rd());
-    auto start = peer_list.begin();
-    auto end = peer_list.end();
-    std::uniform_int_distribution<> dis(0, std::distance(start, end) - 1);
-    std::advance(start, dis(gen));
-    return *start;
+    std::uniform_int_distribution<size_t> dis(0, peer_list.size() - 1);
+    return dis(gen);
 }
 
 void
-RpcBenchmark::dispatch(SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task)
+RpcBenchmark::dispatch(SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task,
+                       size_t thread)
 {
     WireFormat::Common common;
     task->getRequest()->get(0, &common, sizeof(common));
 
     switch (common.opcode) {
         case WireFormat::Benchmark::opcode:
-            handleBenchmarkTask(std::move(task));
+            handleBenchmarkTask(std::move(task), thread);
             break;
         default:
             std::cerr << "Unknown opcode" << std::endl;
@@ -431,25 +1047,32 @@ RpcBenchmark::dispatch(SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task)
 
 void
 RpcBenchmark::handleBenchmarkTask(
-    SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task)
+    SimpleRpc::unique_ptr<SimpleRpc::ServerTask> task, size_t thread)
 {
+    uint64_t const start_tsc = PerfUtils::Cycles::rdtsc();
+    uint64_t const arrival_tsc = task->getArrivalTime();
+    const size_t request_bytes = task->getRequest()->length();
     WireFormat::Benchmark::Request request;
     task->getRequest()->get(0, &request, sizeof(request));
     const BenchConfig::Task& task_config = config.tasks.at(request.taskType);
 
-    const int buf_size = 1000000;
-    char buf[buf_size];
-
     // Only one response is supported.  Take the first one if multiple are
     // configured.
     const BenchConfig::Response& response_config =
         task_config.responses.front();
-    assert(response_config.size <= sizeof(buf));
-    task->reply(buf, response_config.size);
+    task->reply(payloads.response(), response_config.size);
+    uint64_t const stop_tsc = PerfUtils::Cycles::rdtsc();
 
     // Update stats
-    task_stats.at(request.taskType)
-        ->count.fetch_add(1, std::memory_order_relaxed);
+    TaskStats* stats = task_stats.at(request.taskType).get();
+    TaskShard& shard = stats->shards.at(thread);
+    ++shard.count;
+    shard.queueing.record(PerfUtils::Cycles::toNanoseconds(
+        start_tsc > arrival_tsc ? start_tsc - arrival_tsc : 0));
+    shard.service.record(
+        PerfUtils::Cycles::toNanoseconds(stop_tsc - start_tsc));
+    shard.request_bytes.record(request_bytes);
+    shard.response_bytes.record(response_config.size);
 }
 
 }  // namespace RooBench
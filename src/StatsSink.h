@@ -0,0 +1,57 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_STATSSINK_H
+#define ROOBENCH_STATSSINK_H
+
+#include <cstdint>
+#include <string>
+
+#include "Histogram.h"
+
+namespace RooBench {
+
+/**
+ * Destination of the values of a stats sample.
+ *
+ * Each value is identified by a JSON pointer (e.g. "/client_stats/count").
+ * Implemented by the stats dumps and by the live stats segment so that a
+ * benchmark describes its counters once for both.
+ */
+class StatsSink {
+  public:
+    virtual ~StatsSink() = default;
+
+    /// Add a running count to the sample.
+    virtual void counter(const std::string& pointer, uint64_t value) = 0;
+
+    /// Add an unsigned integer value that is not a running count, such as a
+    /// timestamp or an identifier; stored like a counter by default.
+    virtual void gauge(const std::string& pointer, uint64_t value)
+    {
+        counter(pointer, value);
+    }
+
+    /// Add a floating point value to the sample.
+    virtual void number(const std::string& pointer, double value) = 0;
+
+    /// Add a histogram to the sample.
+    virtual void histogram(const std::string& pointer,
+                           const Histogram& histogram) = 0;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_STATSSINK_H
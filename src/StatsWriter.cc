@@ -0,0 +1,207 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "StatsWriter.h"
+
+#include <sstream>
+#include <vector>
+
+namespace RooBench {
+
+const uint32_t StatsWriter::VERSION;
+
+namespace {
+
+/// Magic bytes at the start of every binary stats file.
+const char MAGIC[8] = {'R', 'B', 'S', 'T', 'A', 'T', 'S', '\0'};
+
+/// Percentiles reported for each histogram of the JSON summary.
+const double SUMMARY_PERCENTILES[] = {50, 90, 99, 99.9};
+
+}  // namespace
+
+/**
+ * Create the binary stats file and write its header.
+ *
+ * @param path
+ *      Path of the dump without the file extension; the binary file is
+ *      written to path + ".bin" and the summary to path + ".json".
+ * @param json_summary
+ *      True if a JSON summary should be written as well.
+ */
+StatsWriter::StatsWriter(const std::string& path, bool json_summary)
+    : path(path)
+    , binary(path + ".bin", std::ios::binary | std::ios::trunc)
+    , json_summary(json_summary)
+    , summary(nlohmann::json::object())
+{
+    uint32_t const header[2] = {VERSION, 0};
+    binary.write(MAGIC, sizeof(MAGIC));
+    binary.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+/**
+ * Complete the dump if close() has not been called.
+ */
+StatsWriter::~StatsWriter()
+{
+    close();
+}
+
+/**
+ * Add an unsigned integer value to the dump.
+ */
+void
+StatsWriter::counter(const std::string& pointer, uint64_t value)
+{
+    writeRecord(Type::UINT, pointer, &value, sizeof(value));
+    if (json_summary) {
+        summary[nlohmann::json::json_pointer(pointer)] = value;
+    }
+}
+
+/**
+ * Add a floating point value to the dump.
+ */
+void
+StatsWriter::number(const std::string& pointer, double value)
+{
+    writeRecord(Type::DOUBLE, pointer, &value, sizeof(value));
+    if (json_summary) {
+        summary[nlohmann::json::json_pointer(pointer)] = value;
+    }
+}
+
+/**
+ * Add a string value to the dump.
+ */
+void
+StatsWriter::string(const std::string& pointer, const std::string& value)
+{
+    writeRecord(Type::STRING, pointer, value.data(), value.size());
+    if (json_summary) {
+        summary[nlohmann::json::json_pointer(pointer)] = value;
+    }
+}
+
+/**
+ * Add a structured value to the dump; meant for small values such as the
+ * thread placement.
+ */
+void
+StatsWriter::json(const std::string& pointer, const nlohmann::json& value)
+{
+    std::string const serialized = value.dump();
+    writeRecord(Type::JSON, pointer, serialized.data(), serialized.size());
+    if (json_summary) {
+        summary[nlohmann::json::json_pointer(pointer)] = value;
+    }
+}
+
+/**
+ * Add the nonempty buckets of a histogram to the dump.
+ */
+void
+StatsWriter::histogram(const std::string& pointer, const Histogram& histogram)
+{
+    // Read each count once so that the bucket list stays consistent with
+    // the total even if the histogram's writer is active.  The first word
+    // holds the two 32-bit layout fields.
+    std::vector<uint64_t> payload = {
+        (static_cast<uint64_t>(Histogram::MAX_VALUE_BITS) << 32) |
+            Histogram::SUB_BUCKET_BITS,
+        0, 0};
+    uint64_t total = 0;
+    for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+        uint64_t const count = histogram.count(i);
+        if (count != 0) {
+            payload.push_back(i);
+            payload.push_back(count);
+            total += count;
+        }
+    }
+    payload[1] = total;
+    payload[2] = (payload.size() - 3) / 2;
+    writeRecord(Type::HISTOGRAM, pointer, payload.data(),
+                payload.size() * sizeof(uint64_t));
+
+    if (json_summary) {
+        nlohmann::json histogram_summary;
+        histogram_summary["count"] = total;
+        for (double percentile : SUMMARY_PERCENTILES) {
+            std::ostringstream name;
+            name << "p" << percentile;
+            histogram_summary[name.str()] = histogram.percentile(percentile);
+        }
+        summary[nlohmann::json::json_pointer(pointer)] = histogram_summary;
+    }
+}
+
+/**
+ * Push the records added so far to the binary file so that readers see them
+ * while the dump is still being written.
+ */
+void
+StatsWriter::flush()
+{
+    binary.flush();
+}
+
+/**
+ * Mark the binary file as complete and write the JSON summary.  Nothing may
+ * be added to the dump afterwards.
+ */
+void
+StatsWriter::close()
+{
+    if (!binary.is_open()) {
+        return;
+    }
+    writeRecord(Type::END, "", nullptr, 0);
+    binary.close();
+    if (json_summary) {
+        std::ofstream outfile(path + ".json");
+        outfile << summary.dump();
+    }
+}
+
+/**
+ * Append a record to the binary file.
+ */
+void
+StatsWriter::writeRecord(Type type, const std::string& pointer,
+                         const void* payload, uint64_t length)
+{
+    uint32_t const header[2] = {static_cast<uint32_t>(type),
+                                static_cast<uint32_t>(pointer.size())};
+    binary.write(reinterpret_cast<const char*>(header), sizeof(header));
+    binary.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    binary.write(pointer.data(), pointer.size());
+    writePadding(pointer.size());
+    binary.write(static_cast<const char*>(payload), length);
+    writePadding(length);
+}
+
+/**
+ * Pad a field of the given length to the next 8-byte boundary.
+ */
+void
+StatsWriter::writePadding(uint64_t length)
+{
+    static const char zeros[8] = {};
+    binary.write(zeros, (8 - length % 8) % 8);
+}
+
+}  // namespace RooBench
@@ -0,0 +1,109 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_STATSWRITER_H
+#define ROOBENCH_STATSWRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "Histogram.h"
+#include "StatsSink.h"
+
+namespace RooBench {
+
+/**
+ * Streams a stats dump to a compact binary file and, optionally, a JSON
+ * summary next to it.
+ *
+ * Each value is identified by a JSON pointer (e.g. "/client_stats/count")
+ * so that a dump read back into a document has the same structure as the
+ * former JSON dumps.  Values are written as they are added; nothing but the
+ * optional summary is held in memory.
+ *
+ * Binary format (version 1; little endian, every record 8-byte aligned so
+ * that a reader can mmap the file and access the fields in place):
+ *
+ *   header:  char magic[8] = "RBSTATS\0", uint32 version, uint32 reserved
+ *   record:  uint32 type, uint32 path length, uint64 payload length,
+ *            path, zero padding to 8 bytes, payload, zero padding to 8 bytes
+ *
+ * Payloads by record type:
+ *   UINT       uint64 value
+ *   DOUBLE     IEEE 754 double value
+ *   STRING     bytes of the string
+ *   JSON       bytes of the serialized JSON value
+ *   HISTOGRAM  uint32 sub bucket bits, uint32 max value bits, uint64 count,
+ *              uint64 bucket count, then a (uint64 index, uint64 count) pair
+ *              for every nonempty bucket
+ *   END        empty; the last record of a complete file
+ *
+ * A file without an END record was cut short, e.g. because the process was
+ * killed; the records before the last flush() are intact.
+ *
+ * The JSON summary holds the same values except that histograms are
+ * reduced to their count and a few percentiles.
+ *
+ * This class is NOT thread-safe.
+ */
+class StatsWriter : public StatsSink {
+  public:
+    static const uint32_t VERSION = 1;
+
+    /// Types of the records of the binary format.
+    enum class Type : uint32_t {
+        END = 0,
+        UINT = 1,
+        DOUBLE = 2,
+        STRING = 3,
+        JSON = 4,
+        HISTOGRAM = 5,
+    };
+
+    StatsWriter(const std::string& path, bool json_summary);
+    ~StatsWriter();
+
+    virtual void counter(const std::string& pointer, uint64_t value);
+    virtual void number(const std::string& pointer, double value);
+    void string(const std::string& pointer, const std::string& value);
+    void json(const std::string& pointer, const nlohmann::json& value);
+    virtual void histogram(const std::string& pointer,
+                           const Histogram& histogram);
+    void flush();
+    void close();
+
+  private:
+    void writeRecord(Type type, const std::string& pointer,
+                     const void* payload, uint64_t length);
+    void writePadding(uint64_t length);
+
+    /// Path of the dump without the file extension.
+    const std::string path;
+
+    /// Binary output file.
+    std::ofstream binary;
+
+    /// True if the JSON summary is written when the writer is closed.
+    const bool json_summary;
+
+    /// Summary collected until the writer is closed.
+    nlohmann::json summary;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_STATSWRITER_H
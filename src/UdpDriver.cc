@@ -0,0 +1,476 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "UdpDriver.h"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/udp.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace RooBench {
+
+namespace {
+
+/// Bytes of IPv4 and UDP header overhead per packet.
+const uint32_t HEADER_OVERHEAD = 20 + 8;
+
+/// Largest payload a single UDP datagram (or GSO super-packet) can carry.
+const uint32_t MAX_DATAGRAM_SIZE = 65507;
+
+/// Space needed for the UDP_SEGMENT control message of one sendmmsg() entry.
+const size_t GSO_CONTROL_SIZE = CMSG_SPACE(sizeof(uint16_t));
+
+bool
+sameDestination(const sockaddr_in& a, const sockaddr_in& b)
+{
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+}  // namespace
+
+/**
+ * UdpDriver constructor
+ *
+ * @param config
+ *      Driver configuration parameters.
+ * @throw std::invalid_argument
+ *      If the configured interface has no IPv4 address.
+ * @throw std::system_error
+ *      If the UDP socket could not be created or bound.
+ */
+UdpDriver::UdpDriver(const Config& config)
+    : fd(-1)
+    , localAddress(0)
+    , maxPayloadSize(1500 - HEADER_OVERHEAD)
+    , batchSize(std::max(1, config.batchSize))
+    , gso(config.gso)
+    , bandwidth(config.bandwidth)
+    , poolMutex()
+    , freePackets()
+    , packets()
+    , txMutex()
+    , txBatch(batchSize)
+    , txCount(0)
+    , txMsgs(batchSize)
+    , txIovecs(batchSize)
+    , txControl(batchSize * GSO_CONTROL_SIZE)
+    , rxMutex()
+    , rxPackets()
+    , rxMsgs(batchSize)
+    , rxIovecs(batchSize)
+    , rxAddrs(batchSize)
+{
+#ifndef UDP_SEGMENT
+    gso = false;
+#endif
+
+    // Find the IPv4 address of the configured interface.
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    bool found = false;
+    ifaddrs* ifaddr = nullptr;
+    if (getifaddrs(&ifaddr) != 0) {
+        throw std::system_error(errno, std::generic_category(), "getifaddrs");
+    }
+    for (ifaddrs* ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr != nullptr && ifa->ifa_addr->sa_family == AF_INET &&
+            config.interface == ifa->ifa_name) {
+            addr = *reinterpret_cast<sockaddr_in*>(ifa->ifa_addr);
+            found = true;
+            break;
+        }
+    }
+    freeifaddrs(ifaddr);
+    if (!found) {
+        throw std::invalid_argument("No IPv4 address for interface '" +
+                                    config.interface + "'");
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    // Size packets to the interface MTU.
+    ifreq ifr;
+    std::memset(&ifr, 0, sizeof(ifr));
+    std::strncpy(ifr.ifr_name, config.interface.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFMTU, &ifr) == 0) {
+        maxPayloadSize = std::min(
+            static_cast<uint32_t>(ifr.ifr_mtu) - HEADER_OVERHEAD,
+            MAX_BUFFER_SIZE);
+    }
+
+    // Large socket buffers absorb bursts between polls; best effort only.
+    int bufferSize = 16 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "bind");
+    }
+    socklen_t addrlen = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+    localAddress = toAddress(addr);
+
+    // Post the initial receive buffers.
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (int i = 0; i < batchSize; ++i) {
+        rxPackets.push_back(allocPacketLocked());
+    }
+}
+
+/**
+ * UdpDriver destructor.
+ */
+UdpDriver::~UdpDriver()
+{
+    flushPackets();
+    close(fd);
+}
+
+/**
+ * @copydoc Homa::Driver::getAddress()
+ */
+Homa::Driver::Address
+UdpDriver::getAddress(std::string const* const addressString)
+{
+    size_t separator = addressString->rfind(':');
+    if (separator == std::string::npos) {
+        throw std::invalid_argument("Bad UDP address '" + *addressString +
+                                    "'");
+    }
+    std::string ip = addressString->substr(0, separator);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+        throw std::invalid_argument("Bad UDP address '" + *addressString +
+                                    "'");
+    }
+    addr.sin_port = htons(
+        static_cast<uint16_t>(std::stoi(addressString->substr(separator + 1))));
+    return toAddress(addr);
+}
+
+/**
+ * @copydoc Homa::Driver::getAddress()
+ */
+Homa::Driver::Address
+UdpDriver::getAddress(WireFormatAddress const* const wireAddress)
+{
+    static_assert(sizeof(wireAddress->bytes) >= sizeof(Address),
+                  "WireFormatAddress too small for a UdpDriver address");
+    Address address;
+    std::memcpy(&address, wireAddress->bytes, sizeof(address));
+    return address;
+}
+
+/**
+ * @copydoc Homa::Driver::addressToString()
+ */
+std::string
+UdpDriver::addressToString(const Address address)
+{
+    sockaddr_in addr = toSockaddr(address);
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+}
+
+/**
+ * @copydoc Homa::Driver::addressToWireFormat()
+ */
+void
+UdpDriver::addressToWireFormat(const Address address,
+                               WireFormatAddress* wireAddress)
+{
+    std::memset(wireAddress, 0, sizeof(*wireAddress));
+    std::memcpy(wireAddress->bytes, &address, sizeof(address));
+}
+
+/**
+ * @copydoc Homa::Driver::allocPacket()
+ */
+Homa::Driver::Packet*
+UdpDriver::allocPacket()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    UdpPacket* packet = allocPacketLocked();
+    packet->address = 0;
+    packet->priority = 0;
+    packet->length = 0;
+    return packet;
+}
+
+/**
+ * Queue a copy of the packet in the transmit batch; the batch is sent once it
+ * is full or flushed.
+ *
+ * @copydoc Homa::Driver::sendPacket()
+ */
+void
+UdpDriver::sendPacket(Packet* packet)
+{
+    std::lock_guard<std::mutex> lock(txMutex);
+    TxEntry& entry = txBatch.at(txCount++);
+    entry.destination = toSockaddr(packet->address);
+    entry.length = packet->length;
+    std::memcpy(entry.data, packet->payload, packet->length);
+    if (txCount == batchSize) {
+        flushLocked();
+    }
+}
+
+/**
+ * Send all packets waiting in the transmit batch.
+ */
+void
+UdpDriver::flushPackets()
+{
+    std::lock_guard<std::mutex> lock(txMutex);
+    flushLocked();
+}
+
+/**
+ * @copydoc Homa::Driver::receivePackets()
+ */
+uint32_t
+UdpDriver::receivePackets(uint32_t maxPackets, Packet* receivedPackets[])
+{
+    // The transport polls continuously; use that to push out partial batches.
+    {
+        std::unique_lock<std::mutex> lock(txMutex, std::try_to_lock);
+        if (lock.owns_lock() && txCount > 0) {
+            flushLocked();
+        }
+    }
+
+    // Only one thread needs to drain the socket at a time.
+    std::unique_lock<std::mutex> lock(rxMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return 0;
+    }
+    int count = std::min(static_cast<int>(maxPackets), batchSize);
+    for (int i = 0; i < count; ++i) {
+        rxIovecs[i].iov_base = rxPackets[i]->buf;
+        rxIovecs[i].iov_len = MAX_BUFFER_SIZE;
+        std::memset(&rxMsgs[i], 0, sizeof(mmsghdr));
+        rxMsgs[i].msg_hdr.msg_name = &rxAddrs[i];
+        rxMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        rxMsgs[i].msg_hdr.msg_iov = &rxIovecs[i];
+        rxMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received = recvmmsg(fd, rxMsgs.data(), count, MSG_DONTWAIT, nullptr);
+    if (received <= 0) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> poolLock(poolMutex);
+    for (int i = 0; i < received; ++i) {
+        UdpPacket* packet = rxPackets[i];
+        packet->address = toAddress(rxAddrs[i]);
+        packet->priority = 0;
+        packet->length = rxMsgs[i].msg_len;
+        receivedPackets[i] = packet;
+        rxPackets[i] = allocPacketLocked();
+    }
+    return received;
+}
+
+/**
+ * @copydoc Homa::Driver::releasePackets()
+ */
+void
+UdpDriver::releasePackets(Packet* packets[], uint16_t numPackets)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (uint16_t i = 0; i < numPackets; ++i) {
+        freePackets.push_back(static_cast<UdpPacket*>(packets[i]));
+    }
+}
+
+/**
+ * UDP offers a single priority level.
+ *
+ * @copydoc Homa::Driver::getHighestPacketPriority()
+ */
+int
+UdpDriver::getHighestPacketPriority()
+{
+    return 0;
+}
+
+/**
+ * @copydoc Homa::Driver::getMaxPayloadSize()
+ */
+uint32_t
+UdpDriver::getMaxPayloadSize()
+{
+    return maxPayloadSize;
+}
+
+/**
+ * @copydoc Homa::Driver::getBandwidth()
+ */
+uint32_t
+UdpDriver::getBandwidth()
+{
+    return bandwidth;
+}
+
+/**
+ * @copydoc Homa::Driver::getLocalAddress()
+ */
+Homa::Driver::Address
+UdpDriver::getLocalAddress()
+{
+    return localAddress;
+}
+
+/**
+ * Packets are queued in the kernel, so the driver reports no backlog.
+ *
+ * @copydoc Homa::Driver::getQueuedBytes()
+ */
+uint32_t
+UdpDriver::getQueuedBytes()
+{
+    return 0;
+}
+
+/**
+ * Encode an IPv4 socket address as a Homa::Driver::Address.
+ */
+Homa::Driver::Address
+UdpDriver::toAddress(const sockaddr_in& sockaddr)
+{
+    return (static_cast<Address>(ntohl(sockaddr.sin_addr.s_addr)) << 16) |
+           ntohs(sockaddr.sin_port);
+}
+
+/**
+ * Decode a Homa::Driver::Address into an IPv4 socket address.
+ */
+sockaddr_in
+UdpDriver::toSockaddr(Address address)
+{
+    sockaddr_in sockaddr;
+    std::memset(&sockaddr, 0, sizeof(sockaddr));
+    sockaddr.sin_family = AF_INET;
+    sockaddr.sin_addr.s_addr = htonl(static_cast<uint32_t>(address >> 16));
+    sockaddr.sin_port = htons(static_cast<uint16_t>(address & 0xFFFF));
+    return sockaddr;
+}
+
+/**
+ * Return an unused packet from the pool; poolMutex must be held.
+ */
+UdpDriver::UdpPacket*
+UdpDriver::allocPacketLocked()
+{
+    if (freePackets.empty()) {
+        packets.emplace_back(new UdpPacket(maxPayloadSize));
+        return packets.back().get();
+    }
+    UdpPacket* packet = freePackets.back();
+    freePackets.pop_back();
+    return packet;
+}
+
+/**
+ * Hand the transmit batch to the kernel; txMutex must be held.
+ */
+void
+UdpDriver::flushLocked()
+{
+    // Build one sendmmsg() entry per packet, or per run of packets to the same
+    // destination when GSO is enabled.  All but the last segment of a GSO run
+    // must have the same length.
+    int msgCount = 0;
+    for (int i = 0; i < txCount;) {
+        const TxEntry& first = txBatch[i];
+        int segments = 1;
+        while (gso && i + segments < txCount &&
+               segments < MAX_GSO_SEGMENTS &&
+               (segments + 1) * first.length <= MAX_DATAGRAM_SIZE &&
+               sameDestination(txBatch[i + segments].destination,
+                               first.destination) &&
+               txBatch[i + segments - 1].length == first.length &&
+               txBatch[i + segments].length <= first.length) {
+            ++segments;
+        }
+        for (int j = i; j < i + segments; ++j) {
+            txIovecs[j].iov_base = txBatch[j].data;
+            txIovecs[j].iov_len = txBatch[j].length;
+        }
+        mmsghdr& msg = txMsgs[msgCount];
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_hdr.msg_name = &txBatch[i].destination;
+        msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msg.msg_hdr.msg_iov = &txIovecs[i];
+        msg.msg_hdr.msg_iovlen = segments;
+#ifdef UDP_SEGMENT
+        if (segments > 1) {
+            char* control = &txControl[msgCount * GSO_CONTROL_SIZE];
+            std::memset(control, 0, GSO_CONTROL_SIZE);
+            msg.msg_hdr.msg_control = control;
+            msg.msg_hdr.msg_controllen = GSO_CONTROL_SIZE;
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = first.length;
+            std::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+        }
+#endif
+        ++msgCount;
+        i += segments;
+    }
+
+    int sent = 0;
+    while (sent < msgCount) {
+        int ret = sendmmsg(fd, &txMsgs[sent], msgCount - sent, 0);
+        if (ret > 0) {
+            sent += ret;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK ||
+                   errno == ENOBUFS || errno == EINTR) {
+            // Socket buffer is full; retry until the kernel catches up.
+            continue;
+        } else {
+            // Drop the offending message; Homa recovers lost packets.  A GSO
+            // failure most likely means the kernel or NIC lacks support.
+            if (txMsgs[sent].msg_hdr.msg_iovlen > 1) {
+                gso = false;
+            }
+            ++sent;
+        }
+    }
+    txCount = 0;
+}
+
+}  // namespace RooBench
@@ -0,0 +1,176 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROOBENCH_UDPDRIVER_H
+#define ROOBENCH_UDPDRIVER_H
+
+#include <Homa/Driver.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace RooBench {
+
+/**
+ * A Homa::Driver that sends and receives packets through a kernel UDP socket.
+ *
+ * Outgoing packets are copied into a transmit batch that is handed to the
+ * kernel with a single sendmmsg() call once the batch is full, when
+ * flushPackets() is called, or when the transport next polls for incoming
+ * packets.  Runs of equally sized packets to the same destination are sent
+ * as a single UDP GSO super-packet when GSO is enabled.  Incoming packets are
+ * received in batches with recvmmsg().
+ *
+ * Addresses are IPv4 address and UDP port pairs written as "a.b.c.d:port".
+ *
+ * This class is thread-safe.
+ */
+class UdpDriver : public Homa::Driver {
+  public:
+    /**
+     * UdpDriver configuration parameters
+     */
+    struct Config {
+        /// Name of the network interface whose IPv4 address should be used.
+        std::string interface;
+        /// UDP port to bind; 0 binds an ephemeral port.
+        int port;
+        /// Maximum number of packets sent or received with one system call.
+        int batchSize;
+        /// True if UDP generic segmentation offload should be used.
+        bool gso;
+        /// Link bandwidth reported to the transport in Mbps.
+        uint32_t bandwidth;
+    };
+
+    explicit UdpDriver(const Config& config);
+    virtual ~UdpDriver();
+
+    virtual Address getAddress(std::string const* const addressString);
+    virtual Address getAddress(WireFormatAddress const* const wireAddress);
+    virtual std::string addressToString(const Address address);
+    virtual void addressToWireFormat(const Address address,
+                                     WireFormatAddress* wireAddress);
+    virtual Packet* allocPacket();
+    virtual void sendPacket(Packet* packet);
+    virtual void flushPackets();
+    virtual uint32_t receivePackets(uint32_t maxPackets,
+                                    Packet* receivedPackets[]);
+    virtual void releasePackets(Packet* packets[], uint16_t numPackets);
+    virtual int getHighestPacketPriority();
+    virtual uint32_t getMaxPayloadSize();
+    virtual uint32_t getBandwidth();
+    virtual Address getLocalAddress();
+    virtual uint32_t getQueuedBytes();
+
+  private:
+    /// Largest UDP payload (jumbo frame) any packet buffer can hold.
+    static const uint32_t MAX_BUFFER_SIZE = 9000 - 28;
+
+    /// Maximum number of segments the kernel accepts in one GSO send.
+    static const int MAX_GSO_SEGMENTS = 64;
+
+    /**
+     * Packet buffer handed out to the transport.
+     */
+    struct UdpPacket : public Packet {
+        explicit UdpPacket(uint32_t maxPayloadSize)
+            : Packet(buf, 0)
+            , maxPayloadSize(maxPayloadSize)
+        {}
+
+        virtual int getMaxPayloadSize()
+        {
+            return maxPayloadSize;
+        }
+
+        const uint32_t maxPayloadSize;
+        char buf[MAX_BUFFER_SIZE];
+    };
+
+    /**
+     * Copy of an outgoing packet waiting in the transmit batch.
+     */
+    struct TxEntry {
+        sockaddr_in destination;
+        uint32_t length;
+        char data[MAX_BUFFER_SIZE];
+    };
+
+    static Address toAddress(const sockaddr_in& sockaddr);
+    static sockaddr_in toSockaddr(Address address);
+    UdpPacket* allocPacketLocked();
+    void flushLocked();
+
+    /// UDP socket through which all packets are sent and received.
+    int fd;
+
+    /// Address of this driver's socket.
+    Address localAddress;
+
+    /// Largest payload that fits in one packet on the configured interface.
+    uint32_t maxPayloadSize;
+
+    /// Configured send/receive batch size.
+    const int batchSize;
+
+    /// True if outgoing runs of packets should use UDP GSO.
+    bool gso;
+
+    /// Bandwidth reported to the transport in Mbps.
+    const uint32_t bandwidth;
+
+    /// Protects the packet pool.
+    std::mutex poolMutex;
+
+    /// Packets that are not currently in use.
+    std::vector<UdpPacket*> freePackets;
+
+    /// Every packet ever allocated by this driver.
+    std::vector<std::unique_ptr<UdpPacket>> packets;
+
+    /// Protects the transmit batch.
+    std::mutex txMutex;
+
+    /// Preallocated storage for the transmit batch.
+    std::vector<TxEntry> txBatch;
+
+    /// Number of entries in txBatch waiting to be sent.
+    int txCount;
+
+    /// Message headers, iovecs and control buffers used by sendmmsg().
+    std::vector<mmsghdr> txMsgs;
+    std::vector<iovec> txIovecs;
+    std::vector<char> txControl;
+
+    /// Serializes calls to recvmmsg().
+    std::mutex rxMutex;
+
+    /// Packets posted as receive buffers for the next recvmmsg() call.
+    std::vector<UdpPacket*> rxPackets;
+
+    /// Message headers, iovecs and source addresses used by recvmmsg().
+    std::vector<mmsghdr> rxMsgs;
+    std::vector<iovec> rxIovecs;
+    std::vector<sockaddr_in> rxAddrs;
+};
+
+}  // namespace RooBench
+
+#endif  // ROOBENCH_UDPDRIVER_H
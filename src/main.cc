@@ -16,17 +16,29 @@
 static const char USAGE[] = R"(RooBench server
 
 Usage:
-    server <server_name> <num_threads> <bench_config> <output_dir>
+    server [options] <server_name> <num_threads> <bench_config> <output_dir>
+    server [options] --cluster <num_threads> <bench_config> <output_dir>
 
 Options:
     -h --help           Show this screen.
     --version           Show version.
+    --cluster           Run all nodes of the benchmark in this process using
+                        Homa's FakeDriver (or UDP over ephemeral ports if the
+                        bench config selects the udp driver); <num_threads>
+                        is per node.
+    --control=<path>    Path of the control socket; defaults to
+                        <output_dir>/<server_name>.sock (cluster.sock in
+                        cluster mode).
+    --metrics=<addr>    Serve the stats over HTTP in the Prometheus text
+                        format at [<host>:]<port>; the host defaults to
+                        127.0.0.1.
 )";
 
 #include <docopt.h>
 
 #include "Benchmark.h"
 #include "BenchmarkFactory.h"
+#include "Cluster.h"
 
 int
 main(int argc, char* argv[])
@@ -35,17 +47,41 @@ main(int argc, char* argv[])
         docopt::docopt(USAGE, {argv + 1, argv + argc},
                        true,                    // show help if requested
                        "RooBench server 0.1");  // version string
-    std::string server_name = args["<server_name>"].asString();
     int num_threads = args["<num_threads>"].asLong();
     std::string bench_config = args["<bench_config>"].asString();
     std::string output_dir_path = args["<output_dir>"].asString();
+    std::string control_path;
+    if (args["--control"]) {
+        control_path = args["--control"].asString();
+    }
+    std::string metrics_address;
+    if (args["--metrics"]) {
+        metrics_address = args["--metrics"].asString();
+    }
 
+    if (args["--cluster"].asBool()) {
+        if (control_path.empty()) {
+            control_path = output_dir_path + "/cluster.sock";
+        }
+        RooBench::Cluster* cluster = RooBench::BenchmarkFactory::createCluster(
+            bench_config, output_dir_path, num_threads);
+        if (cluster != nullptr) {
+            cluster->run(control_path, bench_config, metrics_address);
+            delete cluster;
+        }
+        return 0;
+    }
+
+    std::string server_name = args["<server_name>"].asString();
+    if (control_path.empty()) {
+        control_path = output_dir_path + "/" + server_name + ".sock";
+    }
     RooBench::Benchmark* benchmark =
         RooBench::BenchmarkFactory::createBenchmark(
             bench_config, server_name, output_dir_path, num_threads);
 
     if (benchmark != nullptr) {
-        benchmark->run();
+        benchmark->run(control_path, bench_config, metrics_address);
         delete benchmark;
     }
 
@@ -0,0 +1,269 @@
+/* Copyright (c) 2020, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+static const char USAGE[] = R"(RooBench Stats Recording Microbenchmark
+
+Measures the CPU time a client thread spends recording a completed op: the
+op, load step and peer counters plus the step, phase and peer latency
+histograms.  Ops are recorded into per-thread client shards, as the
+benchmarks do, and, as a baseline, with the counters shared by all threads.
+Each thread is pinned to its own CPU while there are enough CPUs, so that
+the counts show the cost of cache lines moving between cores.
+
+Usage:
+    statsbench [options]
+
+Options:
+    -h --help           Show this screen.
+    --version           Show version.
+    --threads=<n>       Largest number of recording threads; the thread
+                        count doubles from 1 up to it. [default: 64]
+    --ops=<n>           Ops recorded by each thread. [default: 10000000]
+    --phases=<n>        Phases of each op. [default: 2]
+    --peers=<n>         Peers the phases are spread over. [default: 4]
+)";
+
+#include <docopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Affinity.h"
+#include "ClientShard.h"
+
+namespace {
+
+using RooBench::ClientShard;
+using RooBench::Histogram;
+
+/**
+ * Counters of completed ops shared by all threads, as the client stats
+ * used to be.  Only a single load step is recorded.
+ */
+struct SharedCounters {
+    explicit SharedCounters(size_t peer_count)
+        : count(0)
+        , offered(0)
+        , lag_cycles(0)
+        , step_count(0)
+        , step_offered(0)
+        , peer_sent(new std::atomic<uint64_t>[peer_count]())
+        , peer_completed(new std::atomic<uint64_t>[peer_count]())
+    {}
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> offered;
+    std::atomic<uint64_t> lag_cycles;
+    std::atomic<uint64_t> step_count;
+    std::atomic<uint64_t> step_offered;
+    std::unique_ptr<std::atomic<uint64_t>[]> peer_sent;
+    std::unique_ptr<std::atomic<uint64_t>[]> peer_completed;
+};
+
+/**
+ * Latency histograms of the ops recorded by a single thread with shared
+ * counters; the histograms have a single writer in either case.
+ */
+struct LatencyShard {
+    LatencyShard(size_t phase_count, size_t peer_count)
+        : step()
+        , phases(phase_count)
+        , peers(peer_count)
+    {}
+
+    Histogram step;
+    std::vector<Histogram> phases;
+    std::vector<Histogram> peers;
+};
+
+/**
+ * Return the latency in nanoseconds of the n-th op, spread over the
+ * histogram buckets so that the recording does not always hit the same one.
+ */
+uint64_t
+op_latency(uint64_t n)
+{
+    return 1000 + (n * 2654435761UL) % 1000000;
+}
+
+/**
+ * Record the n-th op into the given shard the way a client does from
+ * issuing the op to its completion.
+ */
+void
+record_sharded(ClientShard* shard, size_t peer_count, uint64_t n)
+{
+    size_t const phase_count = shard->phases.size();
+    uint64_t const latency = op_latency(n);
+    ++shard->counters.offered;
+    ++shard->step_counters[0].offered;
+    shard->counters.lag_cycles.add(n & 0xff);
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        size_t const peer = (n + phase) % peer_count;
+        ++shard->peer_counters[peer].sent;
+        ++shard->peer_counters[peer].completed;
+        shard->peers[peer].record(latency / phase_count);
+    }
+    shard->steps[0].record(latency);
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        shard->phases[phase].record(latency / phase_count);
+    }
+    ++shard->counters.count;
+    ++shard->step_counters[0].count;
+}
+
+/**
+ * Record the n-th op with the given shared counters and the recording
+ * thread's own histograms.
+ */
+void
+record_shared(SharedCounters* shared, LatencyShard* latency_shard,
+              size_t peer_count, uint64_t n)
+{
+    size_t const phase_count = latency_shard->phases.size();
+    uint64_t const latency = op_latency(n);
+    shared->offered.fetch_add(1, std::memory_order_relaxed);
+    shared->step_offered.fetch_add(1, std::memory_order_relaxed);
+    shared->lag_cycles.fetch_add(n & 0xff, std::memory_order_relaxed);
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        size_t const peer = (n + phase) % peer_count;
+        shared->peer_sent[peer].fetch_add(1, std::memory_order_relaxed);
+        shared->peer_completed[peer].fetch_add(1, std::memory_order_relaxed);
+        latency_shard->peers[peer].record(latency / phase_count);
+    }
+    latency_shard->step.record(latency);
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        latency_shard->phases[phase].record(latency / phase_count);
+    }
+    shared->count.fetch_add(1, std::memory_order_relaxed);
+    shared->step_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Return the CPU time in nanoseconds consumed by the calling thread.
+ */
+uint64_t
+thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/**
+ * Run the given recording function ops times on each of the given number of
+ * threads at once, with thread i pinned to CPU i modulo the number of CPUs.
+ *
+ * CPU time rather than elapsed time is measured so that the cost per op
+ * stays meaningful when there are more threads than CPUs.
+ *
+ * @return
+ *      Average CPU time in nanoseconds per recorded op.
+ */
+template <typename Record>
+double
+measure(size_t threads, size_t cpus, uint64_t ops, Record record)
+{
+    std::atomic<bool> go(false);
+    std::atomic<uint64_t> cpu_ns(0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&go, &cpu_ns, cpus, ops, record, i] {
+            RooBench::Affinity::pinThread(static_cast<int>(i % cpus));
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            uint64_t const start = thread_cpu_ns();
+            for (uint64_t n = 0; n < ops; ++n) {
+                record(i, n);
+            }
+            cpu_ns += thread_cpu_ns() - start;
+        });
+    }
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return static_cast<double>(cpu_ns) / (threads * ops);
+}
+
+}  // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc},
+                       true,                        // show help if requested
+                       "RooBench statsbench 0.1");  // version string
+    size_t const max_threads = args["--threads"].asLong();
+    uint64_t const ops = args["--ops"].asLong();
+    size_t const phase_count = args["--phases"].asLong();
+    size_t const peer_count = args["--peers"].asLong();
+    long const online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t const cpus = online > 0 ? online : 1;
+
+    std::printf("%zu CPUs online; rows marked * share CPUs between threads, "
+                "so their cache lines do not move between cores.\n",
+                cpus);
+    if (max_threads > cpus) {
+        std::fprintf(stderr,
+                     "Only %zu CPUs: whether the recording cost stays flat up "
+                     "to %zu threads is not shown; run on a node with at "
+                     "least %zu CPUs.\n",
+                     cpus, max_threads, max_threads);
+    }
+    std::printf("%8s %16s %16s\n", "threads", "shared (ns/op)",
+                "sharded (ns/op)");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        SharedCounters shared(peer_count);
+        std::vector<LatencyShard> latency_shards(
+            threads, LatencyShard(phase_count, peer_count));
+        double const shared_ns = measure(
+            threads, cpus, ops,
+            [&shared, &latency_shards, peer_count](size_t thread, uint64_t n) {
+                record_shared(&shared, &latency_shards[thread], peer_count, n);
+            });
+
+        std::vector<std::unique_ptr<ClientShard>> shards;
+        for (size_t i = 0; i < threads; ++i) {
+            shards.emplace_back(new ClientShard(1, phase_count, peer_count));
+        }
+        double const sharded_ns = measure(
+            threads, cpus, ops,
+            [&shards, peer_count](size_t thread, uint64_t n) {
+                record_sharded(shards[thread].get(), peer_count, n);
+            });
+
+        // Like a stats dump, sum the shards once all ops are recorded.
+        uint64_t total = 0;
+        for (const std::unique_ptr<ClientShard>& shard : shards) {
+            total += shard->counters.count.load();
+        }
+        if (total != shared.count.load()) {
+            std::fprintf(stderr, "Sharded count %lu differs from %lu\n",
+                         total, shared.count.load());
+            return 1;
+        }
+        std::printf("%8zu %16.2f %16.2f%s\n", threads, shared_ns, sharded_ns,
+                    threads > cpus ? " *" : "");
+    }
+    return 0;
+}